@@ -2,11 +2,13 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
 
 #define MAX_STR_LEN 1024
 
 #ifndef MAT_SIZE
-#define MAT_SIZE 3 // A small graph
+#define MAT_SIZE 3 // A small graph; build with -DMAT_SIZE=<catalog size> for a larger catalog
 #endif
 
 typedef struct user_struct
@@ -15,6 +17,8 @@ typedef struct user_struct
   struct friend_node_struct *friends;
   struct brand_node_struct *brands;
   bool visited;
+  unsigned long version; // Bumped whenever this user's friends or brands change
+  struct lsh_entry_struct *lsh; // LSH band keys, if indexed and following any brand
 } User;
 
 typedef struct friend_node_struct
@@ -34,6 +38,48 @@ FriendNode *allUsers = NULL;
 int brand_adjacency_matrix[MAT_SIZE][MAT_SIZE];
 char brand_names[MAT_SIZE][MAX_STR_LEN];
 
+// Open-addressed name->index table over brand_names, storing index + 1 so
+// that 0 marks an empty slot, and each brand's position in alphabetical order.
+#define BRAND_HASH_SIZE (2 * MAT_SIZE + 1)
+int brand_hash_table[BRAND_HASH_SIZE];
+int brand_name_rank[MAT_SIZE];
+bool brand_index_built = false;
+
+#ifndef SIMILARITY_TOP_K
+#define SIMILARITY_TOP_K 8 // Neighbours kept per brand
+#endif
+
+#ifndef SIMILARITY_THREADS
+#define SIMILARITY_THREADS 4
+#endif
+
+#define SIMILARITY_NONE 0
+#define SIMILARITY_JACCARD 1 // |A and B| / |A or B|
+#define SIMILARITY_PMI 2     // log(P(A and B) / (P(A) P(B))), positive values only
+
+typedef struct brand_neighbor_struct
+{
+  int brand;
+  double weight;
+} BrandNeighbor;
+
+// Weighted brand similarity computed from co-follows. brand_neighbors[b] holds
+// the brand_neighbor_counts[b] strongest neighbours of b, strongest first.
+int brand_similarity_metric = SIMILARITY_NONE;
+int similarity_num_users = 0;
+int brand_follower_counts[MAT_SIZE];
+int brand_cofollow_counts[MAT_SIZE][MAT_SIZE];
+BrandNeighbor brand_neighbors[MAT_SIZE][SIMILARITY_TOP_K];
+int brand_neighbor_counts[MAT_SIZE];
+bool brand_similarity_dirty[MAT_SIZE];
+
+// Version counters used to invalidate cached query results. Every bump takes
+// a fresh value from graph_clock, so no two stamps are ever equal by accident.
+unsigned long graph_clock = 0;
+unsigned long friend_graph_version = 0; // Any friendship added or removed
+unsigned long population_version = 0;   // Any user created or deleted
+unsigned long brand_versions[MAT_SIZE]; // Any follow/unfollow of that brand
+
 /**
  * Given the head to a FriendNode linked list, returns true if a
  * given user's name exists in the list. Returns false otherwise.
@@ -236,22 +282,368 @@ void print_user_data(User *user)
   }
 }
 
+/**
+ * Returns the djb2 hash of a name, for callers to reduce to their own table
+ * size.
+ */
+unsigned long hash_name(char *name)
+{
+  unsigned long h = 5381;
+  for (char *c = name; *c != '\0'; c++)
+    h = h * 33 + (unsigned char)*c;
+  return h;
+}
+
+/**
+ * Returns the slot a brand name hashes to in brand_hash_table.
+ */
+int brand_hash_slot(char *name)
+{
+  return (int)(hash_name(name) % BRAND_HASH_SIZE);
+}
+
+/**
+ * Compares two brand indices by the names they refer to. Used with qsort.
+ */
+int compare_brand_names(const void *a, const void *b)
+{
+  return strcmp(brand_names[*(const int *)a], brand_names[*(const int *)b]);
+}
+
+/**
+ * Rebuilds the name->index hash table and the alphabetical brand ranks from
+ * the brand_names array. populate_brand_matrix calls this; anything that
+ * writes to brand_names directly should call it afterwards.
+ */
+void build_brand_index()
+{
+  memset(brand_hash_table, 0, sizeof(brand_hash_table));
+  for (int i = 0; i < MAT_SIZE; i++)
+  {
+    int slot = brand_hash_slot(brand_names[i]);
+    while (brand_hash_table[slot] != 0 && strcmp(brand_names[brand_hash_table[slot] - 1], brand_names[i]) != 0)
+      slot = (slot + 1) % BRAND_HASH_SIZE;
+    if (brand_hash_table[slot] == 0)
+      brand_hash_table[slot] = i + 1; // Keep the first index of a duplicated name
+  }
+
+  int order[MAT_SIZE];
+  for (int i = 0; i < MAT_SIZE; i++)
+    order[i] = i;
+  qsort(order, MAT_SIZE, sizeof(int), compare_brand_names);
+  for (int i = 0; i < MAT_SIZE; i++)
+  {
+    // Equal names share a rank, so ties fall through to the lower index
+    if (i > 0 && strcmp(brand_names[order[i]], brand_names[order[i - 1]]) == 0)
+      brand_name_rank[order[i]] = brand_name_rank[order[i - 1]];
+    else
+      brand_name_rank[order[i]] = i;
+  }
+  brand_index_built = true;
+}
+
+/**
+ * Given a brand, returns the index of the brand inside the brand_names array
+ * without printing anything, using the table build_brand_index last built.
+ * If it doesn't exist in the array, return -1
+ */
+int find_brand_index(char *name)
+{
+  if (!brand_index_built)
+    build_brand_index();
+
+  for (int slot = brand_hash_slot(name); brand_hash_table[slot] != 0; slot = (slot + 1) % BRAND_HASH_SIZE)
+  {
+    if (strcmp(brand_names[brand_hash_table[slot] - 1], name) == 0)
+      return brand_hash_table[slot] - 1;
+  }
+  return -1;
+}
+
 /**
  * Given a brand, returns the index of the brand inside the brand_names array.
  * If it doesn't exist in the array, return -1
  */
 int get_brand_index(char *name)
 {
-  for (int i = 0; i < MAT_SIZE; i++)
+  int idx = find_brand_index(name);
+  if (idx < 0)
+  {
+    printf("Brand '%s' not found\n", name);
+  }
+  return idx; // -1 if not found
+}
+
+/*
+ * Weighted brand similarity derived from who follows what.
+ *
+ * compute_brand_similarity counts, for every pair of brands, how many users
+ * follow both. It does this as the sparse product of the brand->follower and
+ * follower->brand incidence lists, so the work is proportional to the number
+ * of co-follows rather than to B^2 x users, and splits the brands across
+ * threads. Each brand keeps only its SIMILARITY_TOP_K strongest neighbours.
+ *
+ * Once computed, follows and unfollows keep the co-follow counts up to date
+ * and mark the brands whose neighbours may have changed. Those brands are
+ * re-ranked the next time the neighbours are read.
+ */
+
+typedef struct similarity_job_struct
+{
+  int first_brand; // This thread handles first_brand, first_brand + step, ...
+  int step;
+  int *follower_start; // brand b's followers are followers[follower_start[b] .. follower_start[b + 1])
+  int *followers;
+  int *brand_start; // user u's brands are user_brands[brand_start[u] .. brand_start[u + 1])
+  int *user_brands;
+} SimilarityJob;
+
+/**
+ * Returns the similarity weight between brands a and b under the current
+ * metric, or 0 if they should not be considered neighbours.
+ */
+double brand_similarity_weight(int a, int b)
+{
+  int both = brand_cofollow_counts[a][b];
+  if (both == 0)
+    return 0;
+
+  if (brand_similarity_metric == SIMILARITY_JACCARD)
+    return (double)both / (brand_follower_counts[a] + brand_follower_counts[b] - both);
+
+  double pmi = log((double)both * similarity_num_users /
+                   ((double)brand_follower_counts[a] * brand_follower_counts[b]));
+  return pmi > 0 ? pmi : 0;
+}
+
+/**
+ * Re-ranks the top SIMILARITY_TOP_K neighbours of brand b from the co-follow counts.
+ */
+void rank_brand_neighbors(int b)
+{
+  BrandNeighbor *top = brand_neighbors[b];
+  int count = 0;
+
+  for (int c = 0; c < MAT_SIZE; c++)
+  {
+    double weight = c == b ? 0 : brand_similarity_weight(b, c);
+    if (weight <= 0)
+      continue;
+
+    // Insertion into the sorted list, ties going to reverse-alphabetical order
+    int i = count < SIMILARITY_TOP_K ? count++ : SIMILARITY_TOP_K;
+    while (i > 0 && (top[i - 1].weight < weight ||
+                     (top[i - 1].weight == weight && brand_name_rank[top[i - 1].brand] < brand_name_rank[c])))
+    {
+      if (i < SIMILARITY_TOP_K)
+        top[i] = top[i - 1];
+      i--;
+    }
+    if (i < SIMILARITY_TOP_K)
+    {
+      top[i].brand = c;
+      top[i].weight = weight;
+    }
+  }
+  brand_neighbor_counts[b] = count;
+  brand_similarity_dirty[b] = false;
+}
+
+/**
+ * Thread body for compute_brand_similarity. Fills in the co-follow counts and
+ * neighbour lists of every brand assigned to the job. No two jobs share a
+ * brand, so they write to disjoint rows.
+ */
+void *similarity_worker(void *arg)
+{
+  SimilarityJob *job = arg;
+
+  for (int b = job->first_brand; b < MAT_SIZE; b += job->step)
+  {
+    int *row = brand_cofollow_counts[b];
+    memset(row, 0, MAT_SIZE * sizeof(int));
+    for (int i = job->follower_start[b]; i < job->follower_start[b + 1]; i++)
+    {
+      int u = job->followers[i];
+      for (int j = job->brand_start[u]; j < job->brand_start[u + 1]; j++)
+        row[job->user_brands[j]]++;
+    }
+    brand_follower_counts[b] = job->follower_start[b + 1] - job->follower_start[b];
+  }
+  return NULL;
+}
+
+/**
+ * Drops the weighted brand similarities. follow_suggested_brands and
+ * print_brand_data go back to the brand_adjacency_matrix.
+ */
+void clear_brand_similarity()
+{
+  brand_similarity_metric = SIMILARITY_NONE;
+  memset(brand_neighbor_counts, 0, sizeof(brand_neighbor_counts));
+  memset(brand_similarity_dirty, 0, sizeof(brand_similarity_dirty));
+}
+
+/**
+ * Computes weighted similarity between every pair of brands from the users'
+ * follows, using SIMILARITY_JACCARD or SIMILARITY_PMI, and keeps each brand's
+ * top SIMILARITY_TOP_K neighbours. Until clear_brand_similarity is called,
+ * follow_suggested_brands scores candidates with these weights instead of
+ * the brand_adjacency_matrix. Returns 0 on success, or -1 if the metric is
+ * invalid or memory could not be allocated.
+ */
+int compute_brand_similarity(int metric)
+{
+  if (metric != SIMILARITY_JACCARD && metric != SIMILARITY_PMI)
+  {
+    printf("Invalid similarity metric.\n");
+    return -1;
+  }
+
+  int num_users = 0;
+  int num_follows = 0;
+  for (FriendNode *u = allUsers; u != NULL; u = u->next)
+  {
+    num_users++;
+    for (BrandNode *b = u->user->brands; b != NULL; b = b->next)
+      num_follows++;
+  }
+
+  int *brand_start = malloc((num_users + 1) * sizeof(int));
+  int *user_brands = malloc((num_follows + 1) * sizeof(int));
+  int *follower_start = calloc(MAT_SIZE + 1, sizeof(int));
+  int *followers = malloc((num_follows + 1) * sizeof(int));
+  int *fill = malloc(MAT_SIZE * sizeof(int));
+  if (brand_start == NULL || user_brands == NULL || follower_start == NULL || followers == NULL || fill == NULL)
+  {
+    free(brand_start);
+    free(user_brands);
+    free(follower_start);
+    free(followers);
+    free(fill);
+    return -1;
+  }
+
+  // user -> brands, then transpose into brand -> followers
+  int u = 0;
+  num_follows = 0;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next, u++)
   {
-    if (strcmp(brand_names[i], name) == 0)
+    brand_start[u] = num_follows;
+    for (BrandNode *b = n->user->brands; b != NULL; b = b->next)
     {
-      return i;
+      int idx = find_brand_index(b->brand_name);
+      if (idx >= 0)
+      {
+        user_brands[num_follows++] = idx;
+        follower_start[idx + 1]++;
+      }
     }
   }
+  brand_start[num_users] = num_follows;
+  for (int b = 0; b < MAT_SIZE; b++)
+  {
+    follower_start[b + 1] += follower_start[b];
+    fill[b] = follower_start[b];
+  }
+  for (u = 0; u < num_users; u++)
+  {
+    for (int j = brand_start[u]; j < brand_start[u + 1]; j++)
+      followers[fill[user_brands[j]]++] = u;
+  }
+
+  SimilarityJob jobs[SIMILARITY_THREADS];
+  pthread_t threads[SIMILARITY_THREADS];
+  bool started[SIMILARITY_THREADS];
+  for (int t = 0; t < SIMILARITY_THREADS; t++)
+  {
+    jobs[t] = (SimilarityJob){t, SIMILARITY_THREADS, follower_start, followers, brand_start, user_brands};
+    started[t] = t > 0 && pthread_create(&threads[t], NULL, similarity_worker, &jobs[t]) == 0;
+  }
+  similarity_worker(&jobs[0]);
+  for (int t = 1; t < SIMILARITY_THREADS; t++)
+  {
+    if (started[t])
+      pthread_join(threads[t], NULL);
+    else
+      similarity_worker(&jobs[t]);
+  }
+
+  brand_similarity_metric = metric;
+  similarity_num_users = num_users;
+  for (int b = 0; b < MAT_SIZE; b++)
+    rank_brand_neighbors(b);
+
+  free(brand_start);
+  free(user_brands);
+  free(follower_start);
+  free(followers);
+  free(fill);
+  return 0;
+}
+
+/**
+ * Re-ranks the neighbours of every brand whose co-follow counts changed since
+ * they were last ranked. Does nothing if no similarity has been computed.
+ */
+void refresh_brand_similarity()
+{
+  if (brand_similarity_metric == SIMILARITY_NONE)
+    return;
+  for (int b = 0; b < MAT_SIZE; b++)
+  {
+    if (brand_similarity_dirty[b])
+      rank_brand_neighbors(b);
+  }
+}
+
+/**
+ * Updates the co-follow counts for a user starting (delta = 1) or stopping
+ * (delta = -1) to follow a brand. The brand must not be in the user's brand
+ * list when this is called. Marks the brand, and every brand that shares a
+ * follower with it, as needing to be re-ranked.
+ */
+void note_brand_follow(User *user, int b, int delta)
+{
+  if (brand_similarity_metric == SIMILARITY_NONE || b < 0)
+    return;
+
+  for (BrandNode *other = user->brands; other != NULL; other = other->next)
+  {
+    int c = find_brand_index(other->brand_name);
+    if (c < 0 || c == b)
+      continue;
+    brand_cofollow_counts[b][c] += delta;
+    brand_cofollow_counts[c][b] += delta;
+    brand_similarity_dirty[c] = true;
+  }
+  brand_cofollow_counts[b][b] += delta;
+  brand_follower_counts[b] += delta;
+
+  // b's follower count feeds every weight in b's row and column
+  brand_similarity_dirty[b] = true;
+  for (int c = 0; c < MAT_SIZE; c++)
+  {
+    if (brand_cofollow_counts[b][c] > 0 || brand_cofollow_counts[c][b] > 0)
+      brand_similarity_dirty[c] = true;
+  }
+}
 
-  printf("Brand '%s' not found\n", name);
-  return -1; // Not found
+/**
+ * Updates the user count PMI is computed against after a user is created
+ * (delta = 1) or deleted (delta = -1). Under PMI this shifts every weight,
+ * so every brand is marked as needing to be re-ranked.
+ */
+void note_user_count(int delta)
+{
+  if (brand_similarity_metric == SIMILARITY_NONE)
+    return;
+  similarity_num_users += delta;
+  if (brand_similarity_metric == SIMILARITY_PMI)
+  {
+    for (int b = 0; b < MAT_SIZE; b++)
+      brand_similarity_dirty[b] = true;
+  }
 }
 
 /**
@@ -278,6 +670,17 @@ void print_brand_data(char *brand_name)
       printf("   %s\n", brand_names[i]);
     }
   }
+
+  if (brand_similarity_metric != SIMILARITY_NONE)
+  {
+    refresh_brand_similarity();
+    printf("Weighted similar brands:\n");
+    for (int i = 0; i < brand_neighbor_counts[idx]; i++)
+    {
+      BrandNeighbor *n = &brand_neighbors[idx][i];
+      printf("   %s (%.3f)\n", brand_names[n->brand], n->weight);
+    }
+  }
 }
 
 /**
@@ -320,461 +723,2107 @@ void populate_brand_matrix(char *file_name)
       brand_adjacency_matrix[x][y] = value;
     }
   }
+  build_brand_index();
+  clear_brand_similarity(); // Indices now refer to different brands
 }
 
-/*
-typedef struct user_struct
+/**
+ * Bumps a user's version, dropping any cached result that depends on
+ * their friends or brands.
+ */
+void bump_user_version(User *user)
 {
-  char name[MAX_STR_LEN];
-  struct friend_node_struct *friends;
-  struct brand_node_struct *brands;
-  bool visited;
-} User;
+  if (user != NULL)
+    user->version = ++graph_clock;
+}
 
-typedef struct friend_node_struct
+/**
+ * Bumps the version of the brand at the given index, dropping any cached
+ * suggestion for a user who follows that brand.
+ */
+void bump_brand_version(int brand)
 {
-  User *user;
-  struct friend_node_struct *next;
-} FriendNode;
+  if (brand >= 0)
+    brand_versions[brand] = ++graph_clock;
+}
 
-typedef struct brand_node_struct
-{
-  char brand_name[MAX_STR_LEN];
-  struct brand_node_struct *next;
-} BrandNode;*/
 /**
- * TODO: Complete this function
- * Given a name, creates a new user on the platform and returns the created user.
- * When the user is created, they must also be inserted into the allUsers linked list.
- * If a user already exists with the same name, do nothing and return NULL instead.
+ * Returns a stamp covering every part of the graph a friend suggestion for
+ * the given user depends on, other than the user themself: the set of users
+ * on the platform, and who follows each of the brands the user follows.
+ * A follow elsewhere in the graph cannot change the user's suggestion, so it
+ * leaves this stamp alone.
  */
-
-// bool in_friend_list(FriendNode *head, User *node)
-User *create_user(char *name) // existing test****************************************************************
+unsigned long suggestion_region_stamp(User *user)
 {
-  for (FriendNode *current_user_all_users_friend_node_linked_list = allUsers; current_user_all_users_friend_node_linked_list != NULL; current_user_all_users_friend_node_linked_list = current_user_all_users_friend_node_linked_list->next)
-  {
-    if (strcmp(current_user_all_users_friend_node_linked_list->user->name, name) == 0)
-    {
-      return NULL;
-    }
-  }
-  User *new_user_node_for_test = (User *)calloc(1, sizeof(User));
-  if (new_user_node_for_test == NULL)
+  unsigned long stamp = population_version;
+  for (BrandNode *b = user->brands; b != NULL; b = b->next)
   {
-    return NULL;
+    int idx = find_brand_index(b->brand_name);
+    if (idx >= 0)
+      stamp += brand_versions[idx];
   }
-  strcpy(new_user_node_for_test->name, name);
-  new_user_node_for_test->friends = NULL;
-  new_user_node_for_test->brands = NULL;
-  new_user_node_for_test->visited = false;
-  allUsers = insert_into_friend_list(allUsers, new_user_node_for_test);
-  return new_user_node_for_test;
+  return stamp;
 }
 
-/**
- * TODO: Complete this function
- * Removes a given user from the platform. The user must be removed from the allUsers linked list and the friend list of
- * any users that they belong to. Return 0 if the user was successfully removed.
- * If the user does not exist, return -1 instead.
+/*
+ * Result cache for get_degrees_of_connection and get_suggested_friend.
+ *
+ * Entries live in one fixed array sized from a memory cap, and are found
+ * through a chained hash on (kind, a, b). When the array is full, the CLOCK
+ * algorithm picks a victim: the hand sweeps the array, giving each recently
+ * used entry a second chance before evicting it. Every entry records the
+ * versions it was computed against, and a lookup that finds a mismatch
+ * drops the entry and recomputes.
  */
-int delete_user(User *user) // NO TEST: MANUALLy HAVE TO TEST
+
+#define CACHE_DEGREES 1
+#define CACHE_SUGGESTION 2
+
+typedef struct cache_entry_struct
 {
-  if (!in_friend_list(allUsers, user))
-  {
-    printf("User not in allUsers.\n");
-    return -1;
-  }
-  FriendNode *current_user_node_in_allUsers = allUsers;
-  while (current_user_node_in_allUsers != NULL)
-  {
-    if (current_user_node_in_allUsers->user == user)
-    {
-      current_user_node_in_allUsers = current_user_node_in_allUsers->next;
-      continue;
-    }
-    current_user_node_in_allUsers->user->friends = delete_from_friend_list(current_user_node_in_allUsers->user->friends, user);
-    current_user_node_in_allUsers = current_user_node_in_allUsers->next;
-  }
-  BrandNode *currentBrand = user->brands;
-  while (currentBrand != NULL)
-  {
-    BrandNode *nextBrand = currentBrand->next;
-    free(currentBrand);
-    currentBrand = nextBrand;
-  }
-  allUsers = delete_from_friend_list(allUsers, user);
-  free(user);
+  int kind; // CACHE_DEGREES or CACHE_SUGGESTION, 0 if the slot is free
+  User *a;
+  User *b;
+  unsigned long stamp_a;
+  unsigned long stamp_b;
+  unsigned long stamp_graph;
+  int degrees;
+  User *suggestion;
+  bool referenced; // Set on every hit, cleared as the clock hand passes
+  int next;        // Next entry in the same bucket, or the free list
+} CacheEntry;
+
+typedef struct cache_stats_struct
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long invalidations; // Entries dropped because a version changed
+  unsigned long evictions;     // Entries dropped to make room
+  int entries;
+  int capacity;
+} CacheStats;
+
+CacheEntry *result_cache = NULL;
+int *result_cache_buckets = NULL;
+int result_cache_capacity = 0;
+int result_cache_free_head = -1;
+int result_cache_hand = 0;
+CacheStats result_cache_stats = {0};
 
-  return 0;
+/**
+ * Frees the result cache. Queries go back to computing every result.
+ */
+void result_cache_destroy()
+{
+  free(result_cache);
+  free(result_cache_buckets);
+  result_cache = NULL;
+  result_cache_buckets = NULL;
+  result_cache_capacity = 0;
+  result_cache_free_head = -1;
+  result_cache_hand = 0;
+  memset(&result_cache_stats, 0, sizeof(CacheStats));
 }
 
 /**
- * TODO: Complete this function
- * Given a pair of valid users, create a friendship. A user's friends list must remain in alphabetical order.
- * Return 0 if the friendship was successfully created. Return -1 if the pair were already friends.
+ * Creates a result cache that uses at most max_bytes of memory, replacing
+ * any existing one. Returns 0 on success, or -1 if max_bytes is too small
+ * to hold a single entry or the memory could not be allocated.
  */
-int add_friend(User *user, User *friend) // EXISTING TEST *********************************************
+int result_cache_init(size_t max_bytes)
 {
-  if (user == NULL || friend == NULL)
+  result_cache_destroy();
+
+  int capacity = (int)(max_bytes / (sizeof(CacheEntry) + sizeof(int)));
+  if (capacity <= 0)
   {
-    printf("Invalid users.\n");
+    printf("Cache size too small.\n");
     return -1;
   }
 
-  if (in_friend_list(user->friends, friend) || in_friend_list(friend->friends, user))
+  result_cache = calloc(capacity, sizeof(CacheEntry));
+  result_cache_buckets = malloc(capacity * sizeof(int));
+  if (result_cache == NULL || result_cache_buckets == NULL)
   {
+    result_cache_destroy();
     return -1;
   }
-  friend->friends = insert_into_friend_list(friend->friends, user);
-  user->friends = insert_into_friend_list(user->friends, friend);
+
+  for (int i = 0; i < capacity; i++)
+  {
+    result_cache_buckets[i] = -1;
+    result_cache[i].next = i + 1 < capacity ? i + 1 : -1;
+  }
+  result_cache_capacity = capacity;
+  result_cache_free_head = 0;
+  result_cache_stats.capacity = capacity;
   return 0;
 }
 
 /**
- * TODO: Complete this function
- * Given a paid of valid users, remove their friendship. A user's friends list must remain in alphabetical order.
- * Return 0 if the pair are no longer friends. Return -1 if the pair were not friends to begin with.
+ * Returns the bucket a (kind, a, b) key hashes to.
  */
-int remove_friend(User *user, User *friend) // NO EXISTING TEST: MANUALLY CHECK YOURSELF???????????????????????????????
+int result_cache_bucket(int kind, User *a, User *b)
 {
-  if (user == NULL || friend == NULL)
+  unsigned long h = (unsigned long)(size_t)a * 31 + (unsigned long)(size_t)b;
+  h = (h ^ (h >> 17)) * 0x9E3779B1UL + kind;
+  return (int)(h % (unsigned long)result_cache_capacity);
+}
+
+/**
+ * Unlinks the entry at index idx from its bucket and returns it to the free list.
+ */
+void result_cache_remove(int idx)
+{
+  CacheEntry *e = &result_cache[idx];
+  int *link = &result_cache_buckets[result_cache_bucket(e->kind, e->a, e->b)];
+  while (*link != idx)
+    link = &result_cache[*link].next;
+  *link = e->next;
+
+  e->kind = 0;
+  e->next = result_cache_free_head;
+  result_cache_free_head = idx;
+  result_cache_stats.entries--;
+}
+
+/**
+ * Returns the index of the entry stored under (kind, a, b), or -1 if there
+ * is none. Does not check the entry's stamps or touch the statistics.
+ */
+int result_cache_find(int kind, User *a, User *b)
+{
+  int idx = result_cache_buckets[result_cache_bucket(kind, a, b)];
+  for (; idx != -1; idx = result_cache[idx].next)
   {
-    printf("Invalid users.\n");
+    CacheEntry *e = &result_cache[idx];
+    if (e->kind == kind && e->a == a && e->b == b)
+      break;
+  }
+  return idx;
+}
+
+/**
+ * Looks up a cached result. Returns the entry if it is present and was
+ * computed against the given stamps, NULL otherwise. A present but stale
+ * entry is dropped. Updates the hit and miss counts either way.
+ */
+CacheEntry *result_cache_lookup(int kind, User *a, User *b, unsigned long stamp_a,
+                                unsigned long stamp_b, unsigned long stamp_graph)
+{
+  int idx = result_cache_find(kind, a, b);
+  if (idx != -1)
+  {
+    CacheEntry *e = &result_cache[idx];
+    if (e->stamp_a == stamp_a && e->stamp_b == stamp_b && e->stamp_graph == stamp_graph)
+    {
+      e->referenced = true;
+      result_cache_stats.hits++;
+      return e;
+    }
+    result_cache_remove(idx);
+    result_cache_stats.invalidations++;
+  }
+
+  result_cache_stats.misses++;
+  return NULL;
+}
+
+/**
+ * Stores a new result under (kind, a, b), evicting an entry with the CLOCK
+ * algorithm if the cache is full. Returns the entry so the caller can fill
+ * in the result.
+ */
+CacheEntry *result_cache_insert(int kind, User *a, User *b, unsigned long stamp_a,
+                                unsigned long stamp_b, unsigned long stamp_graph)
+{
+  if (result_cache_free_head == -1)
+  {
+    while (result_cache[result_cache_hand].referenced)
+    {
+      result_cache[result_cache_hand].referenced = false;
+      result_cache_hand = (result_cache_hand + 1) % result_cache_capacity;
+    }
+    result_cache_remove(result_cache_hand);
+    result_cache_hand = (result_cache_hand + 1) % result_cache_capacity;
+    result_cache_stats.evictions++;
+  }
+
+  int idx = result_cache_free_head;
+  CacheEntry *e = &result_cache[idx];
+  result_cache_free_head = e->next;
+
+  int bucket = result_cache_bucket(kind, a, b);
+  e->kind = kind;
+  e->a = a;
+  e->b = b;
+  e->stamp_a = stamp_a;
+  e->stamp_b = stamp_b;
+  e->stamp_graph = stamp_graph;
+  e->referenced = false;
+  e->next = result_cache_buckets[bucket];
+  result_cache_buckets[bucket] = idx;
+  result_cache_stats.entries++;
+  return e;
+}
+
+/**
+ * Prints the result cache's hit, miss, invalidation and eviction counts.
+ */
+void print_result_cache_stats()
+{
+  unsigned long lookups = result_cache_stats.hits + result_cache_stats.misses;
+  printf("Cache entries: %d/%d\n", result_cache_stats.entries, result_cache_stats.capacity);
+  printf("Hits: %lu\n", result_cache_stats.hits);
+  printf("Misses: %lu\n", result_cache_stats.misses);
+  printf("Hit rate: %.1f%%\n", lookups ? 100.0 * result_cache_stats.hits / lookups : 0.0);
+  printf("Invalidations: %lu\n", result_cache_stats.invalidations);
+  printf("Evictions: %lu\n", result_cache_stats.evictions);
+}
+
+/*
+ * MinHash/LSH index over the users' brand sets, for finding users with
+ * similar tastes without scoring everyone on the platform.
+ *
+ * Each user gets a signature of bands x rows MinHash values over the indices
+ * of the brands they follow. Two users agree on any one value with
+ * probability equal to the Jaccard similarity s of their brand sets, so they
+ * share at least one whole band, and become candidates for each other, with
+ * probability 1 - (1 - s^rows)^bands. More bands raise recall; more rows per
+ * band raise precision. Candidates are then ranked by their exact number of
+ * mutually followed brands.
+ */
+
+#ifndef LSH_MAX_HASHES
+#define LSH_MAX_HASHES 128 // Upper bound on bands x rows
+#endif
+
+#define LSH_PRIME 2147483647UL // 2^31 - 1
+
+typedef struct lsh_entry_struct
+{
+  int bands;
+  unsigned long band_keys[]; // One key per band; the signature itself isn't kept
+} LshEntry;
+
+typedef struct lsh_bucket_node_struct
+{
+  int band;
+  unsigned long key;
+  User *user;
+  struct lsh_bucket_node_struct *next;
+} LshBucketNode;
+
+int lsh_bands = 0; // 0 while there is no index
+int lsh_rows = 0;
+unsigned long lsh_hash_a[LSH_MAX_HASHES];
+unsigned long lsh_hash_b[LSH_MAX_HASHES];
+LshBucketNode **lsh_buckets = NULL;
+int lsh_num_buckets = 0;
+int lsh_num_nodes = 0;
+
+/**
+ * Returns the bucket a band key hashes to in a table of the given size.
+ */
+int lsh_bucket_in(int band, unsigned long key, int buckets)
+{
+  return (int)((key ^ ((unsigned long)band * 0x9E3779B97F4A7C15UL)) % (unsigned long)buckets);
+}
+
+/**
+ * Returns the bucket a band key hashes to.
+ */
+int lsh_bucket(int band, unsigned long key)
+{
+  return lsh_bucket_in(band, key, lsh_num_buckets);
+}
+
+/**
+ * Doubles the number of LSH buckets once there are more than two nodes per
+ * bucket, so chains stay short as users are added.
+ */
+void lsh_grow_buckets()
+{
+  if (lsh_num_nodes < 2 * lsh_num_buckets)
+    return;
+
+  int buckets = 2 * lsh_num_buckets + 1;
+  LshBucketNode **table = calloc(buckets, sizeof(LshBucketNode *));
+  if (table == NULL)
+    return;
+  for (int i = 0; i < lsh_num_buckets; i++)
+  {
+    LshBucketNode *node = lsh_buckets[i];
+    while (node != NULL)
+    {
+      LshBucketNode *next = node->next;
+      int bucket = lsh_bucket_in(node->band, node->key, buckets);
+      node->next = table[bucket];
+      table[bucket] = node;
+      node = next;
+    }
+  }
+  free(lsh_buckets);
+  lsh_buckets = table;
+  lsh_num_buckets = buckets;
+}
+
+/**
+ * Removes the given user from the LSH buckets and frees their entry.
+ */
+void lsh_index_remove(User *user)
+{
+  if (lsh_bands == 0 || user == NULL || user->lsh == NULL)
+    return;
+
+  LshEntry *e = user->lsh;
+  for (int band = 0; band < e->bands; band++)
+  {
+    LshBucketNode **link = &lsh_buckets[lsh_bucket(band, e->band_keys[band])];
+    while (*link != NULL && ((*link)->user != user || (*link)->band != band))
+      link = &(*link)->next;
+    if (*link == NULL)
+      continue; // The node could not be allocated when the user was filed
+    LshBucketNode *temp = *link;
+    *link = temp->next;
+    free(temp);
+    lsh_num_nodes--;
+  }
+  free(e);
+  user->lsh = NULL;
+}
+
+/**
+ * Recomputes the given user's MinHash signature from their brands and files
+ * them under their new band keys. Users who follow no brands are left out
+ * of the index.
+ */
+void lsh_index_update(User *user)
+{
+  if (lsh_bands == 0 || user == NULL)
+    return;
+  lsh_index_remove(user);
+
+  unsigned long signature[LSH_MAX_HASHES];
+  int num_hashes = lsh_bands * lsh_rows;
+  for (int i = 0; i < num_hashes; i++)
+    signature[i] = LSH_PRIME;
+
+  bool any_brand = false;
+  for (BrandNode *b = user->brands; b != NULL; b = b->next)
+  {
+    int idx = find_brand_index(b->brand_name);
+    if (idx < 0)
+      continue;
+    any_brand = true;
+    for (int i = 0; i < num_hashes; i++)
+    {
+      unsigned long h = (lsh_hash_a[i] * (unsigned long)idx + lsh_hash_b[i]) % LSH_PRIME;
+      if (h < signature[i])
+        signature[i] = h;
+    }
+  }
+  if (!any_brand)
+    return;
+
+  LshEntry *e = malloc(sizeof(LshEntry) + lsh_bands * sizeof(unsigned long));
+  if (e == NULL)
+    return;
+  e->bands = lsh_bands;
+  user->lsh = e;
+
+  for (int band = 0; band < lsh_bands; band++)
+  {
+    unsigned long key = 14695981039346656037UL;
+    for (int r = 0; r < lsh_rows; r++)
+      key = (key ^ signature[band * lsh_rows + r]) * 1099511628211UL;
+    e->band_keys[band] = key;
+
+    LshBucketNode *node = malloc(sizeof(LshBucketNode));
+    if (node == NULL)
+      continue;
+    int bucket = lsh_bucket(band, key);
+    node->band = band;
+    node->key = key;
+    node->user = user;
+    node->next = lsh_buckets[bucket];
+    lsh_buckets[bucket] = node;
+    lsh_num_nodes++;
+  }
+  lsh_grow_buckets();
+}
+
+/**
+ * Frees the LSH index.
+ */
+void lsh_index_destroy()
+{
+  for (FriendNode *n = allUsers; n != NULL; n = n->next)
+  {
+    if (lsh_bands != 0 && n->user->lsh != NULL)
+      lsh_index_remove(n->user);
+  }
+  free(lsh_buckets);
+  lsh_buckets = NULL;
+  lsh_num_buckets = 0;
+  lsh_num_nodes = 0;
+  lsh_bands = 0;
+  lsh_rows = 0;
+}
+
+/**
+ * Builds an LSH index over every user's brands, replacing any existing one,
+ * with bands x rows MinHash values per user. Once built, follow_brand,
+ * unfollow_brand, create_user and delete_user keep it up to date. Returns 0
+ * on success, or -1 if the parameters are invalid or memory could not be
+ * allocated.
+ */
+int lsh_index_build(int bands, int rows)
+{
+  if (bands <= 0 || rows <= 0 || bands * rows > LSH_MAX_HASHES)
+  {
+    printf("Invalid number of bands or rows.\n");
     return -1;
   }
+  lsh_index_destroy();
 
-  if (!in_friend_list(user->friends, friend) || !in_friend_list(friend->friends, user))
+  int num_users = 0;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next)
+    num_users++;
+
+  lsh_num_buckets = 2 * bands * (num_users > 512 ? num_users : 512) + 1; // Grows with lsh_num_nodes
+  lsh_buckets = calloc(lsh_num_buckets, sizeof(LshBucketNode *));
+  if (lsh_buckets == NULL)
   {
+    lsh_num_buckets = 0;
     return -1;
   }
-  friend->friends = delete_from_friend_list(friend->friends, user);
-  user->friends = delete_from_friend_list(user->friends, friend);
 
+  // A fixed seed keeps signatures, and so results, the same between runs
+  unsigned long seed = 42;
+  for (int i = 0; i < bands * rows; i++)
+  {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    lsh_hash_a[i] = (seed >> 33) % (LSH_PRIME - 1) + 1;
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    lsh_hash_b[i] = (seed >> 33) % LSH_PRIME;
+  }
+
+  lsh_bands = bands;
+  lsh_rows = rows;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next)
+    lsh_index_update(n->user);
   return 0;
 }
 
+/**
+ * Returns the number of brands followed by both a and b. Both brand lists
+ * are kept in alphabetical order, so they are merged in a single pass.
+ */
+int count_mutual_brands(User *a, User *b)
+{
+  int mutual = 0;
+  BrandNode *x = a->brands;
+  BrandNode *y = b->brands;
+  while (x != NULL && y != NULL)
+  {
+    int cmp = strcmp(x->brand_name, y->brand_name);
+    if (cmp == 0)
+      mutual++;
+    if (cmp <= 0)
+      x = x->next;
+    if (cmp >= 0)
+      y = y->next;
+  }
+  return mutual;
+}
+
+/**
+ * Considers a candidate for the k users most similar to user, kept in out
+ * (with their scores in scores) from most to least mutual brands, ties going
+ * to the name that comes first in reverse-alphanumerical order, as in
+ * get_suggested_friend. The user themself and their friends are skipped.
+ * Returns the new number of users in out.
+ */
+int consider_similar_user(User *user, User *candidate, int k, User **out, int *scores, int count)
+{
+  if (candidate == user || in_friend_list(user->friends, candidate))
+    return count;
+
+  int score = count_mutual_brands(user, candidate);
+  int i = count < k ? count++ : k;
+  while (i > 0 && (scores[i - 1] < score ||
+                   (scores[i - 1] == score && strcmp(out[i - 1]->name, candidate->name) < 0)))
+  {
+    if (i < k)
+    {
+      out[i] = out[i - 1];
+      scores[i] = scores[i - 1];
+    }
+    i--;
+  }
+  if (i < k)
+  {
+    out[i] = candidate;
+    scores[i] = score;
+  }
+  return count;
+}
+
+/**
+ * Finds the k users with the most brands in common with the given user by
+ * scoring every user on the platform. The user themself and their friends
+ * are never returned. Fills out with up to k users, most similar first, and
+ * returns how many were found.
+ */
+int get_similar_users(User *user, int k, User **out)
+{
+  if (user == NULL || k <= 0 || out == NULL)
+    return 0;
+
+  int *scores = malloc(k * sizeof(int));
+  if (scores == NULL)
+    return 0;
+  int count = 0;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next)
+    count = consider_similar_user(user, n->user, k, out, scores, count);
+  free(scores);
+  return count;
+}
+
+/**
+ * Like get_similar_users, but only scores the users that share at least one
+ * LSH band with the given user, so users with no brands in common are never
+ * returned and some similar users may be missed. Returns 0 if there is no
+ * LSH index.
+ */
+int get_similar_users_approx(User *user, int k, User **out)
+{
+  if (user == NULL || k <= 0 || out == NULL || lsh_bands == 0 || user->lsh == NULL)
+    return 0;
+
+  int *scores = malloc(k * sizeof(int));
+  int max_seen = 64;
+  int num_seen = 0;
+  User **seen = malloc(max_seen * sizeof(User *));
+  if (scores == NULL || seen == NULL)
+  {
+    free(scores);
+    free(seen);
+    return 0;
+  }
+
+  // visited marks candidates already scored; it is cleared again below
+  user->visited = true;
+  int count = 0;
+  for (int band = 0; band < lsh_bands; band++)
+  {
+    unsigned long key = user->lsh->band_keys[band];
+    for (LshBucketNode *node = lsh_buckets[lsh_bucket(band, key)]; node != NULL; node = node->next)
+    {
+      if (node->band != band || node->key != key || node->user->visited)
+        continue;
+      if (num_seen == max_seen)
+      {
+        User **grown = realloc(seen, 2 * max_seen * sizeof(User *));
+        if (grown == NULL)
+          continue;
+        seen = grown;
+        max_seen *= 2;
+      }
+      node->user->visited = true;
+      seen[num_seen++] = node->user;
+      count = consider_similar_user(user, node->user, k, out, scores, count);
+    }
+  }
+
+  user->visited = false;
+  for (int i = 0; i < num_seen; i++)
+    seen[i]->visited = false;
+  free(seen);
+  free(scores);
+  return count;
+}
+
+/*
+typedef struct user_struct
+{
+  char name[MAX_STR_LEN];
+  struct friend_node_struct *friends;
+  struct brand_node_struct *brands;
+  bool visited;
+} User;
+
+typedef struct friend_node_struct
+{
+  User *user;
+  struct friend_node_struct *next;
+} FriendNode;
+
+typedef struct brand_node_struct
+{
+  char brand_name[MAX_STR_LEN];
+  struct brand_node_struct *next;
+} BrandNode;*/
+/**
+ * TODO: Complete this function
+ * Given a name, creates a new user on the platform and returns the created user.
+ * When the user is created, they must also be inserted into the allUsers linked list.
+ * If a user already exists with the same name, do nothing and return NULL instead.
+ */
+
+// bool in_friend_list(FriendNode *head, User *node)
+User *create_user(char *name) // existing test****************************************************************
+{
+  for (FriendNode *current_user_all_users_friend_node_linked_list = allUsers; current_user_all_users_friend_node_linked_list != NULL; current_user_all_users_friend_node_linked_list = current_user_all_users_friend_node_linked_list->next)
+  {
+    if (strcmp(current_user_all_users_friend_node_linked_list->user->name, name) == 0)
+    {
+      return NULL;
+    }
+  }
+  User *new_user_node_for_test = (User *)calloc(1, sizeof(User));
+  if (new_user_node_for_test == NULL)
+  {
+    return NULL;
+  }
+  strcpy(new_user_node_for_test->name, name);
+  new_user_node_for_test->friends = NULL;
+  new_user_node_for_test->brands = NULL;
+  new_user_node_for_test->visited = false;
+  new_user_node_for_test->version = ++graph_clock;
+  allUsers = insert_into_friend_list(allUsers, new_user_node_for_test);
+  population_version = ++graph_clock;
+  note_user_count(1);
+  lsh_index_update(new_user_node_for_test);
+  return new_user_node_for_test;
+}
+
 /**
  * TODO: Complete this function
- * Given a valid user and the name of a brand, create a link between the user and the brand. A user's brands
- * list must remain in alphabetical order. Return 0 if the link was successfully created.
- * Return -1 if the link already existed or if the brand name is invalid.
+ * Removes a given user from the platform. The user must be removed from the allUsers linked list and the friend list of
+ * any users that they belong to. Return 0 if the user was successfully removed.
+ * If the user does not exist, return -1 instead.
+ */
+int delete_user(User *user) // NO TEST: MANUALLy HAVE TO TEST
+{
+  if (!in_friend_list(allUsers, user))
+  {
+    printf("User not in allUsers.\n");
+    return -1;
+  }
+  FriendNode *current_user_node_in_allUsers = allUsers;
+  while (current_user_node_in_allUsers != NULL)
+  {
+    if (current_user_node_in_allUsers->user == user)
+    {
+      current_user_node_in_allUsers = current_user_node_in_allUsers->next;
+      continue;
+    }
+    if (in_friend_list(current_user_node_in_allUsers->user->friends, user))
+    {
+      bump_user_version(current_user_node_in_allUsers->user);
+    }
+    current_user_node_in_allUsers->user->friends = delete_from_friend_list(current_user_node_in_allUsers->user->friends, user);
+    current_user_node_in_allUsers = current_user_node_in_allUsers->next;
+  }
+  lsh_index_remove(user);
+  BrandNode *currentBrand = user->brands;
+  while (currentBrand != NULL)
+  {
+    BrandNode *nextBrand = currentBrand->next;
+    int brand = find_brand_index(currentBrand->brand_name);
+    user->brands = nextBrand;
+    note_brand_follow(user, brand, -1);
+    bump_brand_version(brand);
+    free(currentBrand);
+    currentBrand = nextBrand;
+  }
+  allUsers = delete_from_friend_list(allUsers, user);
+  free(user);
+  friend_graph_version = ++graph_clock;
+  population_version = ++graph_clock;
+  note_user_count(-1);
+
+  return 0;
+}
+
+/**
+ * TODO: Complete this function
+ * Given a pair of valid users, create a friendship. A user's friends list must remain in alphabetical order.
+ * Return 0 if the friendship was successfully created. Return -1 if the pair were already friends.
+ */
+int add_friend(User *user, User *friend) // EXISTING TEST *********************************************
+{
+  if (user == NULL || friend == NULL)
+  {
+    printf("Invalid users.\n");
+    return -1;
+  }
+
+  if (in_friend_list(user->friends, friend) || in_friend_list(friend->friends, user))
+  {
+    return -1;
+  }
+  friend->friends = insert_into_friend_list(friend->friends, user);
+  user->friends = insert_into_friend_list(user->friends, friend);
+  bump_user_version(user);
+  bump_user_version(friend);
+  friend_graph_version = ++graph_clock;
+  return 0;
+}
+
+/**
+ * TODO: Complete this function
+ * Given a paid of valid users, remove their friendship. A user's friends list must remain in alphabetical order.
+ * Return 0 if the pair are no longer friends. Return -1 if the pair were not friends to begin with.
+ */
+int remove_friend(User *user, User *friend) // NO EXISTING TEST: MANUALLY CHECK YOURSELF???????????????????????????????
+{
+  if (user == NULL || friend == NULL)
+  {
+    printf("Invalid users.\n");
+    return -1;
+  }
+
+  if (!in_friend_list(user->friends, friend) || !in_friend_list(friend->friends, user))
+  {
+    return -1;
+  }
+  friend->friends = delete_from_friend_list(friend->friends, user);
+  user->friends = delete_from_friend_list(user->friends, friend);
+  bump_user_version(user);
+  bump_user_version(friend);
+  friend_graph_version = ++graph_clock;
+
+  return 0;
+}
+
+/**
+ * TODO: Complete this function
+ * Given a valid user and the name of a brand, create a link between the user and the brand. A user's brands
+ * list must remain in alphabetical order. Return 0 if the link was successfully created.
+ * Return -1 if the link already existed or if the brand name is invalid.
+ */
+int follow_brand(User *user, char *brand_name) // existing test
+{
+  if (user == NULL || brand_name == NULL)
+  {
+    printf("Invalid user or brand name.\n");
+    return -1;
+  }
+  if (in_brand_list(user->brands, brand_name))
+  {
+    printf("%s is following %s already.\n", user->name, brand_name);
+    return -1;
+  }
+  int brand_index_in_brand_list = get_brand_index(brand_name);
+  if (brand_index_in_brand_list == -1)
+  {
+    printf("brand non-existent.\n");
+    return -1;
+  }
+  note_brand_follow(user, brand_index_in_brand_list, 1);
+  user->brands = insert_into_brand_list(user->brands, brand_name);
+  bump_user_version(user);
+  bump_brand_version(brand_index_in_brand_list);
+  lsh_index_update(user);
+  return 0;
+}
+
+/**
+ * TODO: Complete this function
+ * Given a valid user and the name of a brand, remove the link between the user and the brand. A user's brands list must remain
+ * in alphabetical order. Return 0 if the link was successfully removed.
+ * Return -1 if the link did not previously exist or if the brand name is invalid.
+ */
+int unfollow_brand(User *user, char *brand_name) // NO EXISTING TEST??????????????????????????
+{
+  if (user == NULL || brand_name == NULL)
+  {
+    printf("Invalid user or name.\n");
+    return -1;
+  }
+  if (!in_brand_list(user->brands, brand_name))
+  {
+    printf("not following");
+    return -1;
+  }
+  int brand_index_in_brand_list = get_brand_index(brand_name);
+  if (brand_index_in_brand_list == -1)
+  {
+    printf("this brand '%s' doesn't exist.\n", brand_name);
+    return -1;
+  }
+  user->brands = delete_from_brand_list(user->brands, brand_name);
+  note_brand_follow(user, brand_index_in_brand_list, -1);
+  bump_user_version(user);
+  bump_brand_version(brand_index_in_brand_list);
+  lsh_index_update(user);
+  return 0;
+}
+
+/**
+ * TODO: Complete this function
+ * Given a pair of valid users, return the number of mutual friends between them.
+ * A mutual friend is a user that exists in the friends list of both User a and User b.
+ */
+int get_mutual_friends(User *a, User *b) // exisiting test
+{
+  if (a == NULL || b == NULL)
+  {
+    printf("Invalid users.\n");
+    return -1;
+  }
+
+  int num_of_mutuals = 0;
+
+  FriendNode *friend_list_of_User_A = a->friends;
+  while (friend_list_of_User_A != NULL)
+  {
+    if (in_friend_list(b->friends, friend_list_of_User_A->user))
+    {
+      num_of_mutuals = num_of_mutuals + 1;
+    }
+    friend_list_of_User_A = friend_list_of_User_A->next;
+  }
+
+  return num_of_mutuals;
+}
+typedef struct bfs_target_struct
+{
+  User *user;
+  int index; // Position of user in the caller's targets array
+} BfsTarget;
+
+/**
+ * Compares two BFS targets by user address. Used with qsort and bsearch.
+ */
+int compare_bfs_targets(const void *a, const void *b)
+{
+  User *x = ((const BfsTarget *)a)->user;
+  User *y = ((const BfsTarget *)b)->user;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Runs one breadth-first search from user a and sets degrees[i] to the
+ * degrees of connection between a and targets[i], or -1 if a connection
+ * cannot be formed. The search stops as soon as every target is reached.
+ * Returns 0, or -1 if memory could not be allocated.
+ */
+int bfs_degrees_of_connection(User *a, User **targets, int num_targets, int *degrees)
+{
+  int num_users = 0;
+  for (FriendNode *current_user_in_allUsers = allUsers; current_user_in_allUsers != NULL; current_user_in_allUsers = current_user_in_allUsers->next)
+  {
+    current_user_in_allUsers->user->visited = false;
+    num_users++;
+  }
+
+  // Targets sorted by user, so each visited user is checked in O(log T)
+  // and a repeated target's positions sit next to each other
+  BfsTarget *sorted = malloc(num_targets * sizeof(BfsTarget));
+  User **queue = malloc((num_users + 1) * sizeof(User *));
+  if (sorted == NULL || queue == NULL)
+  {
+    free(sorted);
+    free(queue);
+    return -1;
+  }
+  for (int i = 0; i < num_targets; i++)
+    sorted[i] = (BfsTarget){targets[i], i};
+  qsort(sorted, num_targets, sizeof(BfsTarget), compare_bfs_targets);
+
+  int remaining = 0;
+  for (int i = 0; i < num_targets; i++)
+  {
+    degrees[i] = targets[i] == a ? 0 : -1;
+    if (targets[i] != a)
+      remaining++;
+  }
+
+  int head = 0;
+  int tail = 0;
+  int level_end = 1;
+  int level = 0;
+  a->visited = true;
+  queue[tail++] = a;
+
+  while (head < tail && remaining > 0)
+  {
+    if (head == level_end)
+    {
+      level++;
+      level_end = tail;
+    }
+    User *cur = queue[head++];
+    for (FriendNode *f = cur->friends; f != NULL; f = f->next)
+    {
+      User *friendUser = f->user;
+      if (friendUser->visited)
+        continue;
+      friendUser->visited = true;
+      queue[tail++] = friendUser;
+
+      BfsTarget key = {friendUser, 0};
+      BfsTarget *hit = bsearch(&key, sorted, num_targets, sizeof(BfsTarget), compare_bfs_targets);
+      if (hit == NULL)
+        continue;
+      while (hit > sorted && hit[-1].user == friendUser)
+        hit--;
+      for (; hit < sorted + num_targets && hit->user == friendUser; hit++)
+      {
+        degrees[hit->index] = level + 1;
+        remaining--;
+      }
+    }
+  }
+
+  free(sorted);
+  free(queue);
+  return 0;
+}
+
+/**
+ * Computes the degrees of connection between two users with a breadth-first
+ * search, without consulting the result cache.
+ */
+int compute_degrees_of_connection(User *a, User *b)
+{
+  if (a == NULL || b == NULL)
+  {
+    return -1;
+  }
+  if (a == b)
+  {
+    return 0;
+  }
+
+  int degrees = -1;
+  bfs_degrees_of_connection(a, &b, 1, &degrees);
+  return degrees;
+}
+
+/**
+ * TODO: Complete this function
+ * A degree of connection is the number of steps it takes to get from
+ * one user to another. Returns a non-negative integer representing
+ * the degrees of connection between two users.Given a pair of valid users, return the degrees of connection between both users.
+ * The "degrees of connection" is the shortest number of steps it takes to get from one user to the other.
+ * If a connection cannot be formed, return -1.
+ */
+int get_degrees_of_connection(User *a, User *b)
+{
+  if (a == NULL || b == NULL)
+  {
+    return -1;
+  }
+  if (result_cache == NULL || a == b)
+  {
+    return compute_degrees_of_connection(a, b);
+  }
+
+  CacheEntry *e = result_cache_lookup(CACHE_DEGREES, a, b, a->version, b->version,
+                                      friend_graph_version);
+  if (e != NULL)
+  {
+    return e->degrees;
+  }
+
+  int degrees = compute_degrees_of_connection(a, b);
+  e = result_cache_insert(CACHE_DEGREES, a, b, a->version, b->version, friend_graph_version);
+  e->degrees = degrees;
+  return degrees;
+}
+
+/**
+ * Given a user and num_targets other users, sets degrees[i] to the degrees of
+ * connection between user a and targets[i], as get_degrees_of_connection
+ * would. Every result missing from the result cache comes out of a single
+ * breadth-first search from a. Returns 0, or -1 if the arguments are invalid
+ * or memory could not be allocated.
+ */
+int get_degrees_of_connection_batch(User *a, User **targets, int num_targets, int *degrees)
+{
+  if (a == NULL || targets == NULL || degrees == NULL || num_targets <= 0)
+  {
+    return -1;
+  }
+
+  User **misses = malloc(num_targets * sizeof(User *));
+  int *miss_index = malloc(num_targets * sizeof(int));
+  int *miss_degrees = malloc(num_targets * sizeof(int));
+  if (misses == NULL || miss_index == NULL || miss_degrees == NULL)
+  {
+    free(misses);
+    free(miss_index);
+    free(miss_degrees);
+    return -1;
+  }
+
+  int num_misses = 0;
+  for (int i = 0; i < num_targets; i++)
+  {
+    User *b = targets[i];
+    degrees[i] = -1;
+    if (b == NULL)
+      continue;
+    if (b == a)
+    {
+      degrees[i] = 0;
+      continue;
+    }
+    CacheEntry *e = result_cache == NULL ? NULL : result_cache_lookup(CACHE_DEGREES, a, b, a->version, b->version, friend_graph_version);
+    if (e != NULL)
+    {
+      degrees[i] = e->degrees;
+      continue;
+    }
+    miss_index[num_misses] = i;
+    misses[num_misses++] = b;
+  }
+
+  int status = 0;
+  if (num_misses > 0)
+  {
+    status = bfs_degrees_of_connection(a, misses, num_misses, miss_degrees);
+    for (int m = 0; status == 0 && m < num_misses; m++)
+    {
+      User *b = misses[m];
+      degrees[miss_index[m]] = miss_degrees[m];
+      if (result_cache != NULL && result_cache_find(CACHE_DEGREES, a, b) == -1) // b may repeat
+      {
+        CacheEntry *e = result_cache_insert(CACHE_DEGREES, a, b, a->version, b->version, friend_graph_version);
+        e->degrees = miss_degrees[m];
+      }
+    }
+  }
+
+  free(misses);
+  free(miss_index);
+  free(miss_degrees);
+  return status;
+}
+
+/**
+ * TODO: Complete this function
+ * Marks two brands as similar.Given two brand names, mark the two brands as similar in the brand_adjacency_matrix variable.
+ * If either brand name is invalid, do nothing.
+ */
+void connect_similar_brands(char *brandNameA, char *brandNameB)
+{
+  if (brandNameA == NULL || brandNameB == NULL)
+  {
+    return;
+  }
+  int brand_index_in_brand_listA = get_brand_index(brandNameA);
+  int brand_index_in_brand_listB = get_brand_index(brandNameB);
+  if (brand_index_in_brand_listA == -1 || brand_index_in_brand_listB == -1)
+  {
+    printf("Invalid brand names.\n");
+    return;
+  }
+  brand_adjacency_matrix[brand_index_in_brand_listB][brand_index_in_brand_listA] = 1;
+  brand_adjacency_matrix[brand_index_in_brand_listA][brand_index_in_brand_listB] = 1;
+}
+
+/**
+ * Scans every user on the platform for the best suggested friend for the
+ * given user, without consulting the result cache.
+ */
+User *compute_suggested_friend(User *user)
+{
+
+  if (user == NULL)
+    return NULL;
+
+  User *most_favourable_suggested_friend = NULL;
+  int max_num_of_mutual_brands = -1;
+
+  for (FriendNode *current_user_in_allUsers = allUsers; current_user_in_allUsers != NULL; current_user_in_allUsers = current_user_in_allUsers->next)
+  {
+
+    User *possible_most_favourable_friend = current_user_in_allUsers->user;
+
+    if (possible_most_favourable_friend == user)
+    {
+      continue;
+    }
+    if (in_friend_list(user->friends, possible_most_favourable_friend))
+    {
+      continue;
+    }
+    int number_of_mutual_brands_between_current_and_brandname = 0;
+    for (BrandNode *current_brand = user->brands; current_brand != NULL; current_brand = current_brand->next)
+    {
+      if (in_brand_list(possible_most_favourable_friend->brands, current_brand->brand_name))
+        number_of_mutual_brands_between_current_and_brandname++;
+    }
+    if ((number_of_mutual_brands_between_current_and_brandname == max_num_of_mutual_brands && strcmp(possible_most_favourable_friend->name, most_favourable_suggested_friend->name) > 0) || number_of_mutual_brands_between_current_and_brandname > max_num_of_mutual_brands)
+    {
+
+      most_favourable_suggested_friend = possible_most_favourable_friend;
+      max_num_of_mutual_brands = number_of_mutual_brands_between_current_and_brandname;
+    }
+  }
+  return most_favourable_suggested_friend;
+}
+
+/**
+ * TODO: Complete this function
+ * Returns a suggested friend for the given user.Given a user, suggest a new friend for them. To find the best match,
+ * the new suggested friend should have the highest number of mutually liked brands amongst all other valid candidates.
+ * If a tie needs to be broken, select the user with the name that comes first in reverse-alphanumerical order.
+ * The suggested friend must be a valid user, cannot be the user themself, nor someone that they're already friends with.
+ * If the user is already friends with everyone on the platform, return NULL.
+ */
+User *get_suggested_friend(User *user)
+{
+  if (user == NULL)
+    return NULL;
+
+  if (result_cache == NULL)
+    return compute_suggested_friend(user);
+
+  unsigned long stamp_graph = suggestion_region_stamp(user);
+  CacheEntry *e = result_cache_lookup(CACHE_SUGGESTION, user, NULL, user->version, 0,
+                                      stamp_graph);
+  if (e != NULL)
+    return e->suggestion;
+
+  User *suggestion = compute_suggested_friend(user);
+  e = result_cache_insert(CACHE_SUGGESTION, user, NULL, user->version, 0, stamp_graph);
+  e->suggestion = suggestion;
+  return suggestion;
+}
+
+/**
+ * TODO: Complete this function
+ * Adds n suggested friends for the given user.
+ * Returns how many friends were successfully followed.
+ *
+ */
+int add_suggested_friends(User *user, int n)
+{
+
+  if (user == NULL)
+  {
+    printf("Invalid user\n");
+    return 0;
+  }
+  if (n <= 0)
+  {
+    return 0;
+  }
+  int friends_successfully_added_to_users_friendlist = 0;
+
+  while (friends_successfully_added_to_users_friendlist < n)
+  {
+    User *best_suggested_friend_current = get_suggested_friend(user);
+
+    if (best_suggested_friend_current == NULL)
+    {
+      break;
+    }
+    if (best_suggested_friend_current != user && !in_friend_list(user->friends, best_suggested_friend_current))
+    {
+      user->friends = insert_into_friend_list(user->friends, best_suggested_friend_current);
+      bump_user_version(user);
+      friend_graph_version = ++graph_clock;
+      friends_successfully_added_to_users_friendlist++;
+    }
+  }
+  return friends_successfully_added_to_users_friendlist;
+}
+
+/*
+ * Brand suggestions keep, for every brand the user does not follow yet, a
+ * score of how similar it is to the user's brands: the number of them it is
+ * marked similar to in brand_adjacency_matrix, or the sum of its weights to
+ * them once compute_brand_similarity has run. The candidates sit in a
+ * max-heap ordered by that score, then by reverse-alphabetical name. After
+ * each pick, the scores of brands similar to the picked one go up and those
+ * brands sift up, so each pick costs O(B log B) rather than a full rescan of
+ * the catalog for every followed brand.
+ */
+
+typedef struct brand_heap_struct
+{
+  double scores[MAT_SIZE]; // Similarity of each brand to the followed brands
+  int pos[MAT_SIZE];    // Position of each brand in heap, -1 if not in it
+  int heap[MAT_SIZE];
+  int size;
+} BrandHeap;
+
+/**
+ * Returns true if brand a should be suggested before brand b.
+ */
+bool brand_heap_before(BrandHeap *h, int a, int b)
+{
+  if (h->scores[a] != h->scores[b])
+    return h->scores[a] > h->scores[b];
+  if (brand_name_rank[a] != brand_name_rank[b])
+    return brand_name_rank[a] > brand_name_rank[b];
+  return a < b;
+}
+
+/**
+ * Swaps the brands at two positions of the heap.
+ */
+void brand_heap_swap(BrandHeap *h, int i, int j)
+{
+  int tmp = h->heap[i];
+  h->heap[i] = h->heap[j];
+  h->heap[j] = tmp;
+  h->pos[h->heap[i]] = i;
+  h->pos[h->heap[j]] = j;
+}
+
+/**
+ * Moves the brand at position i up the heap until its parent comes before it.
+ */
+void brand_heap_sift_up(BrandHeap *h, int i)
+{
+  while (i > 0 && brand_heap_before(h, h->heap[i], h->heap[(i - 1) / 2]))
+  {
+    brand_heap_swap(h, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+/**
+ * Moves the brand at position i down the heap until it comes before both children.
+ */
+void brand_heap_sift_down(BrandHeap *h, int i)
+{
+  while (true)
+  {
+    int best = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+    if (left < h->size && brand_heap_before(h, h->heap[left], h->heap[best]))
+      best = left;
+    if (right < h->size && brand_heap_before(h, h->heap[right], h->heap[best]))
+      best = right;
+    if (best == i)
+      return;
+    brand_heap_swap(h, i, best);
+    i = best;
+  }
+}
+
+/**
+ * Adds followed brand f's similarity to the score of every brand similar to
+ * it. Brands still in the heap are sifted up if sift is true.
+ */
+void add_brand_similarity(BrandHeap *h, int f, bool sift)
+{
+  if (brand_similarity_metric == SIMILARITY_NONE)
+  {
+    for (int j = 0; j < MAT_SIZE; j++)
+    {
+      if (brand_adjacency_matrix[j][f] == 1)
+      {
+        h->scores[j]++;
+        if (sift && h->pos[j] != -1)
+          brand_heap_sift_up(h, h->pos[j]);
+      }
+    }
+    return;
+  }
+
+  for (int i = 0; i < brand_neighbor_counts[f]; i++)
+  {
+    int j = brand_neighbors[f][i].brand;
+    h->scores[j] += brand_neighbors[f][i].weight;
+    if (sift && h->pos[j] != -1)
+      brand_heap_sift_up(h, h->pos[j]);
+  }
+}
+
+/**
+ * Follows up to n suggested brands for the given user, using h as scratch
+ * space. Returns how many brands were followed.
+ */
+int follow_suggested_brands_with_heap(User *user, int n, BrandHeap *h)
+{
+  bool followed[MAT_SIZE] = {false};
+  memset(h->scores, 0, sizeof(h->scores));
+  refresh_brand_similarity();
+
+  // Resolve the user's brands once and add up their similarities
+  for (BrandNode *b = user->brands; b != NULL; b = b->next)
+  {
+    int f = get_brand_index(b->brand_name);
+    if (f == -1 || followed[f])
+      continue;
+    followed[f] = true;
+    add_brand_similarity(h, f, false);
+  }
+
+  h->size = 0;
+  for (int j = 0; j < MAT_SIZE; j++)
+  {
+    h->pos[j] = followed[j] ? -1 : h->size;
+    if (!followed[j])
+      h->heap[h->size++] = j;
+  }
+  for (int i = h->size / 2 - 1; i >= 0; i--)
+    brand_heap_sift_down(h, i);
+
+  int num_of_brands_followed = 0;
+  while (num_of_brands_followed < n && h->size > 0)
+  {
+    int best = h->heap[0];
+    brand_heap_swap(h, 0, --h->size);
+    h->pos[best] = -1;
+    brand_heap_sift_down(h, 0);
+
+    // A duplicated name resolves to its first index, as get_brand_index does
+    int f = find_brand_index(brand_names[best]);
+    if (!followed[f])
+      note_brand_follow(user, f, 1);
+    user->brands = insert_into_brand_list(user->brands, brand_names[best]);
+    bump_user_version(user);
+    bump_brand_version(f);
+    num_of_brands_followed++;
+
+    // The picked brand now counts towards every brand similar to it
+    if (followed[f])
+      continue;
+    followed[f] = true;
+    add_brand_similarity(h, f, true);
+  }
+  if (num_of_brands_followed > 0)
+    lsh_index_update(user);
+  return num_of_brands_followed;
+}
+
+/**
+ * TODO: Complete this function
+ * Follows n suggested brands for the given user.
+ * Returns how many brands were successfully followed.
+ * Given a user and a positive interger n, suggest n new brands for them.
+ * To find the best matches, suggested brands with the most similarities with the brands that the user already follows.
+ * If a tie needs to be broken, select the brand with the name that comes first in reverse-alphanumerical order.
+ * The suggested brand must be a valid brand and cannot be a brand that the user already follows.
+ * There might not be enough brands on the platform to sastify n, so return the amount of brands successfully followed.
+ * Like add_suggested_friends, sometimes, adding a brand with a similarity rating of 0 is the best option.
+ */
+int follow_suggested_brands(User *user, int n)
+{
+  if (user == NULL || n <= 0)
+  {
+    printf("Invalid user or invalid number of suggested brands.\n");
+    return 0;
+  }
+
+  BrandHeap *h = malloc(sizeof(BrandHeap));
+  if (h == NULL)
+    return 0;
+  int num_of_brands_followed = follow_suggested_brands_with_heap(user, n, h);
+  free(h);
+  return num_of_brands_followed;
+}
+
+/**
+ * Follows n suggested brands for each of the num_users given users, the same
+ * way follow_suggested_brands does, sharing one scratch heap between them.
+ * If num_followed is not NULL, num_followed[i] is set to how many brands
+ * users[i] followed. Returns the total number of brands followed.
+ */
+int follow_suggested_brands_batch(User **users, int num_users, int n, int *num_followed)
+{
+  if (users == NULL || num_users <= 0 || n <= 0)
+  {
+    printf("Invalid users or invalid number of suggested brands.\n");
+    return 0;
+  }
+
+  BrandHeap *h = malloc(sizeof(BrandHeap));
+  if (h == NULL)
+    return 0;
+
+  int total = 0;
+  for (int i = 0; i < num_users; i++)
+  {
+    int followed = users[i] != NULL ? follow_suggested_brands_with_heap(users[i], n, h) : 0;
+    if (num_followed != NULL)
+      num_followed[i] = followed;
+    total += followed;
+  }
+  free(h);
+  return total;
+}
+
+/*
+ * Sharded snapshot of the platform, an in-process model of a partitioned
+ * deployment used to measure ghost edges and message traffic.
+ *
+ * shard_graph_build hash-partitions the users into num_shards shards by
+ * name. Each shard owns its users' names, brands and friend lists in its own
+ * arrays, and refers to users elsewhere only by (shard, local id): friend
+ * edges between two users of the same shard are local edges, the rest are
+ * ghost edges. Shards never read each other's arrays. Everything a query
+ * needs from another shard travels as a batch of ints through that shard's
+ * mailbox, so the same code can later move the mailboxes into shared memory
+ * or onto sockets to run each shard in its own process.
+ *
+ * The snapshot is for testing and benchmarking only. shard_graph_build copies
+ * from allUsers, so the whole graph must already be in memory, and while the
+ * snapshot exists the process holds the graph twice. Running shards on
+ * graphs that do not fit in one process would need a loader that builds each
+ * shard from its own slice of the input, which this file does not have.
+ *
+ * Degrees of connection use a level-synchronous breadth-first search. In each
+ * superstep, every shard expands its frontier and batches the ghost
+ * endpoints it reaches per destination shard. Each shard then drains its
+ * mailboxes into its next frontier.
+ */
+
+typedef struct ghost_edge_struct
+{
+  int shard; // Shard that owns the friend
+  int user;  // Friend's local id in that shard
+} GhostEdge;
+
+typedef struct shard_mailbox_struct
+{
+  int *items;
+  int len;
+  int cap;
+} ShardMailbox;
+
+typedef struct shard_struct
+{
+  int num_users;
+  char **names;
+  int *name_table; // Open-addressed name -> local id + 1, 0 if empty
+  int name_table_size;
+  int *local_start; // User u's same-shard friends are local_adj[local_start[u] .. local_start[u + 1])
+  int *local_adj;
+  int *ghost_start; // User u's other friends are ghost_adj[ghost_start[u] .. ghost_start[u + 1])
+  GhostEdge *ghost_adj;
+  int *brand_start; // User u's brands are brands[brand_start[u] .. brand_start[u + 1]), sorted
+  int *brands;
+  int *level; // Search scratch: BFS level, or -1 if not reached
+  int *frontier;
+  int frontier_len;
+  int *next_frontier;
+  int next_len;
+  ShardMailbox *inbox; // One per sending shard
+  size_t bytes;        // Memory owned by this shard
+} Shard;
+
+typedef struct sharded_graph_struct
+{
+  int num_shards;
+  Shard *shards;
+  unsigned long messages;        // Ints sent between shards
+  unsigned long message_batches; // Non-empty mailboxes delivered
+} ShardedGraph;
+
+typedef struct user_location_struct
+{
+  User *user;
+  int shard;
+  int local;
+} UserLocation;
+
+/**
+ * Returns the shard that owns the user with the given name.
+ */
+int shard_of(char *name, int num_shards)
+{
+  return (int)(hash_name(name) % num_shards);
+}
+
+/**
+ * Allocates count elements of size bytes for a shard and adds them to its
+ * memory total. Returns NULL if memory could not be allocated.
+ */
+void *shard_alloc(Shard *s, size_t count, size_t size)
+{
+  void *p = calloc(count ? count : 1, size);
+  if (p != NULL)
+    s->bytes += (count ? count : 1) * size;
+  return p;
+}
+
+/**
+ * Appends an int to a mailbox. Returns 0, or -1 if memory could not be allocated.
+ */
+int shard_send(ShardedGraph *g, int from, int to, int value)
+{
+  ShardMailbox *m = &g->shards[to].inbox[from];
+  if (m->len == m->cap)
+  {
+    int cap = m->cap ? 2 * m->cap : 64;
+    int *grown = realloc(m->items, cap * sizeof(int));
+    if (grown == NULL)
+      return -1;
+    g->shards[to].bytes += (cap - m->cap) * sizeof(int);
+    m->items = grown;
+    m->cap = cap;
+  }
+  m->items[m->len++] = value;
+  g->messages++;
+  return 0;
+}
+
+/**
+ * Returns the local id of the user with the given name in shard s, or -1.
+ */
+int shard_find_user(Shard *s, char *name)
+{
+  for (int slot = (int)(hash_name(name) % s->name_table_size); s->name_table[slot] != 0;
+       slot = (slot + 1) % s->name_table_size)
+  {
+    if (strcmp(s->names[s->name_table[slot] - 1], name) == 0)
+      return s->name_table[slot] - 1;
+  }
+  return -1;
+}
+
+/**
+ * Compares two user locations by user address. Used with qsort and bsearch.
+ */
+int compare_user_locations(const void *a, const void *b)
+{
+  User *x = ((const UserLocation *)a)->user;
+  User *y = ((const UserLocation *)b)->user;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Compares two longs. Used with qsort.
+ */
+int compare_longs(const void *a, const void *b)
+{
+  long x = *(const long *)a;
+  long y = *(const long *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Compares two ints. Used with qsort.
+ */
+int compare_ints(const void *a, const void *b)
+{
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Frees a sharded graph.
  */
-int follow_brand(User *user, char *brand_name) // existing test
+void shard_graph_free(ShardedGraph *g)
 {
-  if (user == NULL || brand_name == NULL)
-  {
-    printf("Invalid user or brand name.\n");
-    return -1;
-  }
-  if (in_brand_list(user->brands, brand_name))
-  {
-    printf("%s is following %s already.\n", user->name, brand_name);
-    return -1;
-  }
-  int brand_index_in_brand_list = get_brand_index(brand_name);
-  if (brand_index_in_brand_list == -1)
+  if (g == NULL)
+    return;
+  for (int i = 0; i < g->num_shards; i++)
   {
-    printf("brand non-existent.\n");
-    return -1;
+    Shard *s = &g->shards[i];
+    for (int u = 0; s->names != NULL && u < s->num_users; u++)
+      free(s->names[u]);
+    free(s->names);
+    free(s->name_table);
+    free(s->local_start);
+    free(s->local_adj);
+    free(s->ghost_start);
+    free(s->ghost_adj);
+    free(s->brand_start);
+    free(s->brands);
+    free(s->level);
+    free(s->frontier);
+    free(s->next_frontier);
+    for (int j = 0; s->inbox != NULL && j < g->num_shards; j++)
+      free(s->inbox[j].items);
+    free(s->inbox);
   }
-  user->brands = insert_into_brand_list(user->brands, brand_name);
-  return 0;
+  free(g->shards);
+  free(g);
 }
 
 /**
- * TODO: Complete this function
- * Given a valid user and the name of a brand, remove the link between the user and the brand. A user's brands list must remain
- * in alphabetical order. Return 0 if the link was successfully removed.
- * Return -1 if the link did not previously exist or if the brand name is invalid.
+ * Fills in shard s's users from the platform. locations maps every user to
+ * their shard and local id, sorted by user address.
  */
-int unfollow_brand(User *user, char *brand_name) // NO EXISTING TEST??????????????????????????
+int shard_fill(ShardedGraph *g, int id, UserLocation *locations, int num_users)
 {
-  if (user == NULL || brand_name == NULL)
+  Shard *s = &g->shards[id];
+  int n = s->num_users;
+
+  int num_local = 0;
+  int num_ghost = 0;
+  int num_brands = 0;
+  for (int i = 0; i < num_users; i++)
   {
-    printf("Invalid user or name.\n");
-    return -1;
+    if (locations[i].shard != id)
+      continue;
+    for (FriendNode *f = locations[i].user->friends; f != NULL; f = f->next)
+    {
+      if (shard_of(f->user->name, g->num_shards) == id)
+        num_local++;
+      else
+        num_ghost++;
+    }
+    for (BrandNode *b = locations[i].user->brands; b != NULL; b = b->next)
+      num_brands++;
   }
-  if (!in_brand_list(user->brands, brand_name))
-  {
-    printf("not following");
+
+  s->names = shard_alloc(s, n, sizeof(char *));
+  s->name_table_size = 2 * n + 1;
+  s->name_table = shard_alloc(s, s->name_table_size, sizeof(int));
+  s->local_start = shard_alloc(s, n + 1, sizeof(int));
+  s->local_adj = shard_alloc(s, num_local, sizeof(int));
+  s->ghost_start = shard_alloc(s, n + 1, sizeof(int));
+  s->ghost_adj = shard_alloc(s, num_ghost, sizeof(GhostEdge));
+  s->brand_start = shard_alloc(s, n + 1, sizeof(int));
+  s->brands = shard_alloc(s, num_brands, sizeof(int));
+  s->level = shard_alloc(s, n, sizeof(int));
+  s->frontier = shard_alloc(s, n, sizeof(int));
+  s->next_frontier = shard_alloc(s, n, sizeof(int));
+  s->inbox = shard_alloc(s, g->num_shards, sizeof(ShardMailbox));
+  if (s->names == NULL || s->name_table == NULL || s->local_start == NULL || s->local_adj == NULL ||
+      s->ghost_start == NULL || s->ghost_adj == NULL || s->brand_start == NULL || s->brands == NULL ||
+      s->level == NULL || s->frontier == NULL || s->next_frontier == NULL || s->inbox == NULL)
     return -1;
-  }
-  int brand_index_in_brand_list = get_brand_index(brand_name);
-  if (brand_index_in_brand_list == -1)
-  {
-    printf("this brand '%s' doesn't exist.\n", brand_name);
+
+  // Local ids follow allUsers order, which is what locations[].local holds
+  int *by_local = malloc((n + 1) * sizeof(int));
+  if (by_local == NULL)
     return -1;
+  for (int i = 0; i < num_users; i++)
+  {
+    if (locations[i].shard == id)
+      by_local[locations[i].local] = i;
   }
-  user->brands = delete_from_brand_list(user->brands, brand_name);
-  return 0;
-}
 
-/**
- * TODO: Complete this function
- * Given a pair of valid users, return the number of mutual friends between them.
- * A mutual friend is a user that exists in the friends list of both User a and User b.
- */
-int get_mutual_friends(User *a, User *b) // exisiting test
-{
-  if (a == NULL || b == NULL)
+  num_local = 0;
+  num_ghost = 0;
+  num_brands = 0;
+  for (int u = 0; u < n; u++)
   {
-    printf("Invalid users.\n");
-    return -1;
-  }
+    User *user = locations[by_local[u]].user;
+    s->names[u] = malloc(strlen(user->name) + 1);
+    if (s->names[u] == NULL)
+    {
+      free(by_local);
+      return -1;
+    }
+    strcpy(s->names[u], user->name);
+    s->bytes += strlen(user->name) + 1;
 
-  int num_of_mutuals = 0;
+    int slot = (int)(hash_name(user->name) % s->name_table_size);
+    while (s->name_table[slot] != 0)
+      slot = (slot + 1) % s->name_table_size;
+    s->name_table[slot] = u + 1;
 
-  FriendNode *friend_list_of_User_A = a->friends;
-  while (friend_list_of_User_A != NULL)
-  {
-    if (in_friend_list(b->friends, friend_list_of_User_A->user))
+    s->local_start[u] = num_local;
+    s->ghost_start[u] = num_ghost;
+    for (FriendNode *f = user->friends; f != NULL; f = f->next)
     {
-      num_of_mutuals = num_of_mutuals + 1;
+      UserLocation key = {f->user, 0, 0};
+      UserLocation *loc = bsearch(&key, locations, num_users, sizeof(UserLocation), compare_user_locations);
+      if (loc == NULL)
+        continue; // Friend is not on the platform any more
+      if (loc->shard == id)
+        s->local_adj[num_local++] = loc->local;
+      else
+        s->ghost_adj[num_ghost++] = (GhostEdge){loc->shard, loc->local};
     }
-    friend_list_of_User_A = friend_list_of_User_A->next;
-  }
 
-  return num_of_mutuals;
+    s->brand_start[u] = num_brands;
+    for (BrandNode *b = user->brands; b != NULL; b = b->next)
+    {
+      int idx = find_brand_index(b->brand_name);
+      if (idx >= 0)
+        s->brands[num_brands++] = idx;
+    }
+    qsort(s->brands + s->brand_start[u], num_brands - s->brand_start[u], sizeof(int), compare_ints);
+    s->level[u] = -1;
+  }
+  s->local_start[n] = num_local;
+  s->ghost_start[n] = num_ghost;
+  s->brand_start[n] = num_brands;
+  free(by_local);
+  return 0;
 }
+
 /**
- * TODO: Complete this function
- * A degree of connection is the number of steps it takes to get from
- * one user to another. Returns a non-negative integer representing
- * the degrees of connection between two users.Given a pair of valid users, return the degrees of connection between both users.
- * The "degrees of connection" is the shortest number of steps it takes to get from one user to the other.
- * If a connection cannot be formed, return -1.
+ * Takes a snapshot of the platform partitioned into num_shards shards by a
+ * hash of each user's name. The snapshot is copied from the fully resident
+ * allUsers and is meant for tests and benchmarks. Later changes to the
+ * platform are not reflected in the snapshot. Returns NULL if num_shards is
+ * not positive or memory could not be allocated.
  */
-int get_degrees_of_connection(User *a, User *b)
+ShardedGraph *shard_graph_build(int num_shards)
 {
-
-  if (a == NULL || b == NULL)
+  if (num_shards <= 0)
   {
-    return -1;
+    printf("Invalid number of shards.\n");
+    return NULL;
   }
-  if (a == b)
+
+  int num_users = 0;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next)
+    num_users++;
+
+  ShardedGraph *g = calloc(1, sizeof(ShardedGraph));
+  UserLocation *locations = malloc((num_users + 1) * sizeof(UserLocation));
+  if (g == NULL || locations == NULL || (g->shards = calloc(num_shards, sizeof(Shard))) == NULL)
   {
-    return 0;
+    free(g);
+    free(locations);
+    return NULL;
   }
-  for (FriendNode *current_user_in_allUsers = allUsers; current_user_in_allUsers != NULL; current_user_in_allUsers = current_user_in_allUsers->next)
+  g->num_shards = num_shards;
+
+  int i = 0;
+  for (FriendNode *n = allUsers; n != NULL; n = n->next, i++)
   {
-    current_user_in_allUsers->user->visited = false;
+    int shard = shard_of(n->user->name, num_shards);
+    locations[i] = (UserLocation){n->user, shard, g->shards[shard].num_users++};
   }
+  qsort(locations, num_users, sizeof(UserLocation), compare_user_locations);
 
-  int degrees = 0;
-  int current_level_users = 1;
-  int next_level_users = 0;
-
-  a->visited = true;
+  for (int s = 0; s < num_shards; s++)
+  {
+    if (shard_fill(g, s, locations, num_users) != 0)
+    {
+      free(locations);
+      shard_graph_free(g);
+      return NULL;
+    }
+  }
+  free(locations);
+  return g;
+}
 
-  while (current_level_users > 0)
+/**
+ * Delivers every shard's mailboxes: each received local id that has not been
+ * reached yet is given the given level and added to the next frontier.
+ */
+void shard_exchange_frontiers(ShardedGraph *g, int level)
+{
+  for (int to = 0; to < g->num_shards; to++)
   {
-    for (int i = 0; i < current_level_users; ++i)
+    Shard *s = &g->shards[to];
+    for (int from = 0; from < g->num_shards; from++)
     {
-      User *current_user_looked_for = a;
-      for (int j = 0; j < i; ++j)
+      ShardMailbox *m = &s->inbox[from];
+      if (m->len > 0)
+        g->message_batches++;
+      for (int i = 0; i < m->len; i++)
       {
-        current_user_looked_for = current_user_looked_for->friends->next->user;
-      }
-      FriendNode *current_Friend_looked_at = current_user_looked_for->friends;
-      while (current_Friend_looked_at != NULL)
-      {
-        User *friendUser = current_Friend_looked_at->user;
-        if (friendUser == b)
-        {
-          return degrees + 1;
-        }
-        if (!friendUser->visited)
+        int v = m->items[i];
+        if (s->level[v] == -1)
         {
-          friendUser->visited = true;
-          next_level_users++;
+          s->level[v] = level;
+          s->next_frontier[s->next_len++] = v;
         }
-        current_Friend_looked_at = current_Friend_looked_at->next;
       }
+      m->len = 0;
     }
-    degrees = degrees + 1;
-    current_level_users = next_level_users;
-    next_level_users = 0;
   }
-  return -1;
 }
 
 /**
- * TODO: Complete this function
- * Marks two brands as similar.Given two brand names, mark the two brands as similar in the brand_adjacency_matrix variable.
- * If either brand name is invalid, do nothing.
+ * Drops every undelivered message, after a query gives up part way.
  */
-void connect_similar_brands(char *brandNameA, char *brandNameB)
+void shard_clear_mailboxes(ShardedGraph *g)
 {
-  if (brandNameA == NULL || brandNameB == NULL)
-  {
-    return;
-  }
-  int brand_index_in_brand_listA = get_brand_index(brandNameA);
-  int brand_index_in_brand_listB = get_brand_index(brandNameB);
-  if (brand_index_in_brand_listA == -1 || brand_index_in_brand_listB == -1)
+  for (int to = 0; to < g->num_shards; to++)
   {
-    printf("Invalid brand names.\n");
-    return;
+    for (int from = 0; from < g->num_shards; from++)
+      g->shards[to].inbox[from].len = 0;
   }
-  brand_adjacency_matrix[brand_index_in_brand_listB][brand_index_in_brand_listA] = 1;
-  brand_adjacency_matrix[brand_index_in_brand_listA][brand_index_in_brand_listB] = 1;
 }
 
 /**
- * TODO: Complete this function
- * Returns a suggested friend for the given user.Given a user, suggest a new friend for them. To find the best match,
- * the new suggested friend should have the highest number of mutually liked brands amongst all other valid candidates.
- * If a tie needs to be broken, select the user with the name that comes first in reverse-alphanumerical order.
- * The suggested friend must be a valid user, cannot be the user themself, nor someone that they're already friends with.
- * If the user is already friends with everyone on the platform, return NULL.
+ * Returns the degrees of connection between the users with the given names,
+ * as get_degrees_of_connection would, using a level-synchronous search
+ * across the shards. Returns -1 if a connection cannot be formed, either
+ * user is not in the snapshot, or a mailbox cannot grow.
  */
-User *get_suggested_friend(User *user)
+int sharded_degrees_of_connection(ShardedGraph *g, char *name_a, char *name_b)
 {
+  if (g == NULL || name_a == NULL || name_b == NULL)
+    return -1;
+  int sa = shard_of(name_a, g->num_shards);
+  int sb = shard_of(name_b, g->num_shards);
+  int a = shard_find_user(&g->shards[sa], name_a);
+  int b = shard_find_user(&g->shards[sb], name_b);
+  if (a < 0 || b < 0)
+    return -1;
+  if (sa == sb && a == b)
+    return 0;
 
-  if (user == NULL)
-    return NULL;
-
-  User *most_favourable_suggested_friend = NULL;
-  int max_num_of_mutual_brands = -1;
-
-  for (FriendNode *current_user_in_allUsers = allUsers; current_user_in_allUsers != NULL; current_user_in_allUsers = current_user_in_allUsers->next)
+  for (int i = 0; i < g->num_shards; i++)
   {
+    Shard *s = &g->shards[i];
+    for (int u = 0; u < s->num_users; u++)
+      s->level[u] = -1;
+    s->frontier_len = 0;
+  }
+  g->shards[sa].level[a] = 0;
+  g->shards[sa].frontier[g->shards[sa].frontier_len++] = a;
 
-    User *possible_most_favourable_friend = current_user_in_allUsers->user;
-
-    if (possible_most_favourable_friend == user)
-    {
-      continue;
-    }
-    if (in_friend_list(user->friends, possible_most_favourable_friend))
+  int result = -1;
+  for (int level = 1; result == -1; level++)
+  {
+    bool any = false;
+    for (int i = 0; i < g->num_shards; i++)
     {
-      continue;
+      Shard *s = &g->shards[i];
+      s->next_len = 0;
+      for (int k = 0; k < s->frontier_len; k++)
+      {
+        int u = s->frontier[k];
+        for (int e = s->local_start[u]; e < s->local_start[u + 1]; e++)
+        {
+          int v = s->local_adj[e];
+          if (s->level[v] == -1)
+          {
+            s->level[v] = level;
+            s->next_frontier[s->next_len++] = v;
+          }
+        }
+        for (int e = s->ghost_start[u]; e < s->ghost_start[u + 1]; e++)
+        {
+          if (shard_send(g, i, s->ghost_adj[e].shard, s->ghost_adj[e].user) != 0)
+          {
+            shard_clear_mailboxes(g);
+            return -1;
+          }
+        }
+      }
     }
-    int number_of_mutual_brands_between_current_and_brandname = 0;
-    for (BrandNode *current_brand = user->brands; current_brand != NULL; current_brand = current_brand->next)
+    shard_exchange_frontiers(g, level);
+
+    for (int i = 0; i < g->num_shards; i++)
     {
-      if (in_brand_list(possible_most_favourable_friend->brands, current_brand->brand_name))
-        number_of_mutual_brands_between_current_and_brandname++;
+      Shard *s = &g->shards[i];
+      int *temp = s->frontier;
+      s->frontier = s->next_frontier;
+      s->next_frontier = temp;
+      s->frontier_len = s->next_len;
+      any = any || s->frontier_len > 0;
     }
-    if ((number_of_mutual_brands_between_current_and_brandname == max_num_of_mutual_brands && strcmp(possible_most_favourable_friend->name, most_favourable_suggested_friend->name) > 0) || number_of_mutual_brands_between_current_and_brandname > max_num_of_mutual_brands)
-    {
 
-      most_favourable_suggested_friend = possible_most_favourable_friend;
-      max_num_of_mutual_brands = number_of_mutual_brands_between_current_and_brandname;
-    }
+    if (g->shards[sb].level[b] != -1)
+      result = g->shards[sb].level[b];
+    else if (!any)
+      break;
   }
-  return most_favourable_suggested_friend;
+  return result;
 }
 
 /**
- * TODO: Complete this function
- * Adds n suggested friends for the given user.
- * Returns how many friends were successfully followed.
- *
+ * Sends the friends of local user u of shard from to shard to, as
+ * (shard, local id) pairs. Returns 0, or -1 if the mailbox cannot grow.
  */
-int add_suggested_friends(User *user, int n)
+int shard_send_friends(ShardedGraph *g, int from, int u, int to)
 {
-
-  if (user == NULL)
+  Shard *s = &g->shards[from];
+  for (int e = s->local_start[u]; e < s->local_start[u + 1]; e++)
   {
-    printf("Invalid user\n");
-    return 0;
+    if (shard_send(g, from, to, from) != 0 || shard_send(g, from, to, s->local_adj[e]) != 0)
+      return -1;
   }
-  if (n <= 0)
+  for (int e = s->ghost_start[u]; e < s->ghost_start[u + 1]; e++)
   {
-    return 0;
+    if (shard_send(g, from, to, s->ghost_adj[e].shard) != 0 || shard_send(g, from, to, s->ghost_adj[e].user) != 0)
+      return -1;
   }
-  int friends_successfully_added_to_users_friendlist = 0;
+  return 0;
+}
 
-  while (friends_successfully_added_to_users_friendlist < n)
+/**
+ * Returns the number of mutual friends between the users with the given
+ * names, as get_mutual_friends would. The first user's shard sends their
+ * friend list to the second user's shard, which intersects it with the
+ * second user's friends. Returns -1 if either user is not in the snapshot
+ * or memory runs out.
+ */
+int sharded_mutual_friends(ShardedGraph *g, char *name_a, char *name_b)
+{
+  if (g == NULL || name_a == NULL || name_b == NULL)
+    return -1;
+  int sa = shard_of(name_a, g->num_shards);
+  int sb = shard_of(name_b, g->num_shards);
+  int a = shard_find_user(&g->shards[sa], name_a);
+  int b = shard_find_user(&g->shards[sb], name_b);
+  if (a < 0 || b < 0)
+    return -1;
+
+  if (shard_send_friends(g, sa, a, sb) != 0)
   {
-    User *best_suggested_friend_current = get_suggested_friend(user);
+    shard_clear_mailboxes(g);
+    return -1;
+  }
+  g->message_batches++;
+
+  // Everything below runs on b's shard
+  Shard *s = &g->shards[sb];
+  ShardMailbox *m = &s->inbox[sa];
+  int num_b = s->local_start[b + 1] - s->local_start[b] + s->ghost_start[b + 1] - s->ghost_start[b];
+  long *mine = malloc((num_b + 1) * sizeof(long));
+  long *theirs = malloc((m->len / 2 + 1) * sizeof(long));
+  if (mine == NULL || theirs == NULL)
+  {
+    free(mine);
+    free(theirs);
+    m->len = 0;
+    return -1;
+  }
 
-    if (best_suggested_friend_current == NULL)
-    {
-      break;
-    }
-    if (best_suggested_friend_current != user && !in_friend_list(user->friends, best_suggested_friend_current))
+  // Encode each friend as shard * 2^32 + local id so the lists sort and merge
+  int k = 0;
+  for (int e = s->local_start[b]; e < s->local_start[b + 1]; e++)
+    mine[k++] = ((long)sb << 32) | s->local_adj[e];
+  for (int e = s->ghost_start[b]; e < s->ghost_start[b + 1]; e++)
+    mine[k++] = ((long)s->ghost_adj[e].shard << 32) | s->ghost_adj[e].user;
+  int num_theirs = m->len / 2;
+  for (int i = 0; i < num_theirs; i++)
+    theirs[i] = ((long)m->items[2 * i] << 32) | m->items[2 * i + 1];
+  m->len = 0;
+
+  qsort(mine, num_b, sizeof(long), compare_longs);
+  qsort(theirs, num_theirs, sizeof(long), compare_longs);
+
+  int mutual = 0;
+  for (int i = 0, j = 0; i < num_b && j < num_theirs;)
+  {
+    if (mine[i] == theirs[j])
     {
-      user->friends = insert_into_friend_list(user->friends, best_suggested_friend_current);
-      friends_successfully_added_to_users_friendlist++;
+      mutual++;
+      i++;
+      j++;
     }
+    else if (mine[i] < theirs[j])
+      i++;
+    else
+      j++;
   }
-  return friends_successfully_added_to_users_friendlist;
+  free(mine);
+  free(theirs);
+  return mutual;
 }
 
 /**
- * TODO: Complete this function
- * Follows n suggested brands for the given user.
- * Returns how many brands were successfully followed.
- * Given a user and a positive interger n, suggest n new brands for them.
- * To find the best matches, suggested brands with the most similarities with the brands that the user already follows.
- * If a tie needs to be broken, select the brand with the name that comes first in reverse-alphanumerical order.
- * The suggested brand must be a valid brand and cannot be a brand that the user already follows.
- * There might not be enough brands on the platform to sastify n, so return the amount of brands successfully followed.
- * Like add_suggested_friends, sometimes, adding a brand with a similarity rating of 0 is the best option.
+ * Returns a suggested friend for the user with the given name, chosen as
+ * get_suggested_friend would. The user's brands and friends are broadcast to
+ * every shard; each shard picks its own best candidate, and the best of
+ * those wins. Returns the name of the suggested friend, owned by the
+ * snapshot, or NULL if there is none, the user is not in the snapshot or a
+ * mailbox cannot grow.
  */
-int follow_suggested_brands(User *user, int n)
+char *sharded_suggested_friend(ShardedGraph *g, char *name)
 {
-  if (user == NULL || n <= 0)
-  {
-    printf("Invalid user or invalid number of suggested brands.\n");
-    return 0;
-  }
+  if (g == NULL || name == NULL)
+    return NULL;
+  int su = shard_of(name, g->num_shards);
+  Shard *home = &g->shards[su];
+  int u = shard_find_user(home, name);
+  if (u < 0)
+    return NULL;
 
-  int num_of_brands_followed = 0;
-  int *brands_already_followed_currently = (int *)calloc(MAT_SIZE, sizeof(int));
-  for (BrandNode *current_brand_node_in_user_brandlist = user->brands; current_brand_node_in_user_brandlist != NULL; current_brand_node_in_user_brandlist = current_brand_node_in_user_brandlist->next)
+  int num_brands = home->brand_start[u + 1] - home->brand_start[u];
+  int *user_brands = home->brands + home->brand_start[u];
+
+  char *best_name = NULL;
+  int best_score = -1;
+  for (int d = 0; d < g->num_shards; d++)
   {
-    int brand_index_in_brand_list = get_brand_index(current_brand_node_in_user_brandlist->brand_name);
-    if (brand_index_in_brand_list != -1)
+    // Broadcast: the brand count, the brands, then the friends as pairs
+    bool sent = shard_send(g, su, d, num_brands) == 0;
+    for (int i = 0; sent && i < num_brands; i++)
+      sent = shard_send(g, su, d, user_brands[i]) == 0;
+    if (!sent || shard_send_friends(g, su, u, d) != 0)
     {
-      brands_already_followed_currently[brand_index_in_brand_list] = 1;
+      shard_clear_mailboxes(g);
+      return NULL;
+    }
+    g->message_batches++;
+
+    // Everything below runs on shard d
+    Shard *s = &g->shards[d];
+    ShardMailbox *m = &s->inbox[su];
+    int count = m->items[0];
+    int *brands = m->items + 1;
+
+    // Mark the user and their friends in this shard as excluded
+    if (d == su)
+      s->level[u] = -2;
+    for (int i = 1 + count; i + 1 < m->len; i += 2)
+    {
+      if (m->items[i] == d)
+        s->level[m->items[i + 1]] = -2;
     }
-  }
-  for (int i = 0; i < n; i++)
-  {
-    int most_similar_for_comparison = -1;
-    int best_brand_in_brand_list = -1;
 
-    for (int brand_index_in_brand_list = 0; brand_index_in_brand_list < MAT_SIZE; brand_index_in_brand_list++)
+    char *local_name = NULL;
+    int local_score = -1;
+    for (int v = 0; v < s->num_users; v++)
     {
-      if (brands_already_followed_currently[brand_index_in_brand_list] == 0)
+      if (s->level[v] == -2)
+        continue;
+      int score = 0;
+      for (int i = s->brand_start[v], j = 0; i < s->brand_start[v + 1] && j < count;)
       {
-        int similarity_of_brands_in_comapre = 0;
-
-        for (BrandNode *current_brand_node_in_user_brandlist = user->brands; current_brand_node_in_user_brandlist != NULL; current_brand_node_in_user_brandlist = current_brand_node_in_user_brandlist->next)
-        {
-          int cur_brand_index_in_brand_list = get_brand_index(current_brand_node_in_user_brandlist->brand_name);
-          if (brand_adjacency_matrix[brand_index_in_brand_list][cur_brand_index_in_brand_list] == 1)
-          {
-            similarity_of_brands_in_comapre++;
-          }
-        }
-
-        if (similarity_of_brands_in_comapre > most_similar_for_comparison)
-        {
-          most_similar_for_comparison = similarity_of_brands_in_comapre;
-          best_brand_in_brand_list = brand_index_in_brand_list;
-        }
-        else if (similarity_of_brands_in_comapre == most_similar_for_comparison)
+        if (s->brands[i] == brands[j])
         {
-          if (strcmp(brand_names[brand_index_in_brand_list], brand_names[best_brand_in_brand_list]) > 0)
-          {
-            best_brand_in_brand_list = brand_index_in_brand_list;
-          }
+          score++;
+          i++;
+          j++;
         }
+        else if (s->brands[i] < brands[j])
+          i++;
+        else
+          j++;
+      }
+      if (score > local_score || (score == local_score && strcmp(s->names[v], local_name) > 0))
+      {
+        local_score = score;
+        local_name = s->names[v];
       }
     }
 
-    if (best_brand_in_brand_list != -1)
+    if (d == su)
+      s->level[u] = -1;
+    for (int i = 1 + count; i + 1 < m->len; i += 2)
+    {
+      if (m->items[i] == d)
+        s->level[m->items[i + 1]] = -1;
+    }
+    m->len = 0;
+
+    // Reduce: the shard's candidate comes back as (score, name)
+    if (local_name != NULL &&
+        (local_score > best_score || (local_score == best_score && strcmp(local_name, best_name) > 0)))
     {
-      user->brands = insert_into_brand_list(user->brands, brand_names[best_brand_in_brand_list]);
-      brands_already_followed_currently[best_brand_in_brand_list] = 1;
-      num_of_brands_followed++;
+      best_score = local_score;
+      best_name = local_name;
     }
   }
-  free(brands_already_followed_currently);
-  return num_of_brands_followed;
+  return best_name;
+}
+
+/**
+ * Prints how many users, local edges and ghost edges each shard holds, and
+ * how much memory it owns.
+ */
+void print_shard_stats(ShardedGraph *g)
+{
+  for (int i = 0; i < g->num_shards; i++)
+  {
+    Shard *s = &g->shards[i];
+    printf("Shard %d: %d users, %d local edges, %d ghost edges, %zu bytes\n", i, s->num_users,
+           s->local_start[s->num_users], s->ghost_start[s->num_users], s->bytes);
+  }
+  printf("Messages: %lu ints in %lu batches\n", g->messages, g->message_batches);
 }
@@ -0,0 +1,230 @@
+/**
+ * Benchmark for graffit.c. Builds a random platform, compares the exact
+ * similar-user search against the MinHash/LSH index for recall and latency,
+ * and measures query throughput and memory per shard of sharded snapshots.
+ *
+ * Build and run with:
+ *   gcc -O2 graffit_bench.c -o graffit_bench -lm -pthread
+ *   ./graffit_bench [num_users] [num_queries]
+ */
+
+#ifndef MAT_SIZE
+#define MAT_SIZE 512
+#endif
+
+#include <time.h>
+#include "graffit.c"
+
+#define BENCH_TOP_K 10
+#define BENCH_MAX_BRANDS_PER_USER 40
+
+/**
+ * Returns the current time in seconds.
+ */
+double now_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns a pseudo-random brand index skewed towards a few popular brands
+ * within each of 16 taste clusters, so that users in the same cluster share
+ * brands the way real audiences do.
+ */
+int random_brand(int cluster)
+{
+  int cluster_size = MAT_SIZE / 16;
+  if (rand() % 4 == 0)
+    return rand() % MAT_SIZE; // Occasional brand outside the user's taste
+  int r = rand() % (cluster_size * cluster_size);
+  int offset = cluster_size - 1 - (int)sqrt((double)r); // Lower offsets more likely
+  return cluster * cluster_size + offset;
+}
+
+/**
+ * Creates num_users users, each following a random set of brands, and a
+ * sparse set of friendships.
+ */
+User **build_platform(int num_users)
+{
+  for (int i = 0; i < MAT_SIZE; i++)
+    sprintf(brand_names[i], "brand%04d", i);
+  build_brand_index();
+
+  User **users = malloc(num_users * sizeof(User *));
+  for (int i = 0; i < num_users; i++)
+  {
+    char name[MAX_STR_LEN];
+    sprintf(name, "user%07d", i);
+    users[i] = create_user(name);
+  }
+  for (int i = 0; i < num_users; i++)
+  {
+    int cluster = rand() % 16;
+    int num_brands = 1 + rand() % BENCH_MAX_BRANDS_PER_USER;
+    for (int j = 0; j < num_brands; j++)
+    {
+      char *brand = brand_names[random_brand(cluster)];
+      if (!in_brand_list(users[i]->brands, brand))
+        follow_brand(users[i], brand);
+    }
+    for (int j = 0; j < 3; j++)
+    {
+      User *friend = users[rand() % num_users];
+      if (friend != users[i])
+        add_friend(users[i], friend);
+    }
+  }
+  return users;
+}
+
+/**
+ * Runs num_queries exact and approximate similar-user searches with the given
+ * LSH shape and prints recall and average latency. Recall is the fraction of
+ * the exact top-k (counting only users with at least one brand in common)
+ * that the approximate search matched in score.
+ */
+void bench_lsh(User **users, int num_users, int num_queries, int bands, int rows)
+{
+  double start = now_seconds();
+  lsh_index_build(bands, rows);
+  double build_time = now_seconds() - start;
+
+  User *exact[BENCH_TOP_K];
+  User *approx[BENCH_TOP_K];
+  double exact_time = 0;
+  double approx_time = 0;
+  long relevant = 0;
+  long found = 0;
+
+  srand(1234); // The same query users for every LSH shape
+  for (int q = 0; q < num_queries; q++)
+  {
+    User *user = users[rand() % num_users];
+
+    start = now_seconds();
+    int num_exact = get_similar_users(user, BENCH_TOP_K, exact);
+    exact_time += now_seconds() - start;
+
+    start = now_seconds();
+    int num_approx = get_similar_users_approx(user, BENCH_TOP_K, approx);
+    approx_time += now_seconds() - start;
+
+    // Scores decrease down both lists, so the i-th approximate result
+    // matches the i-th exact one if it has at least as many mutual brands
+    for (int i = 0; i < num_exact; i++)
+    {
+      int exact_score = count_mutual_brands(user, exact[i]);
+      if (exact_score == 0)
+        break;
+      relevant++;
+      if (i < num_approx && count_mutual_brands(user, approx[i]) >= exact_score)
+        found++;
+    }
+  }
+
+  printf("LSH %2d bands x %2d rows: recall@%d %.3f, exact %.1f us/query, approx %.1f us/query, build %.1f ms\n",
+         bands, rows, BENCH_TOP_K, relevant ? (double)found / relevant : 1.0,
+         1e6 * exact_time / num_queries, 1e6 * approx_time / num_queries, 1e3 * build_time);
+  lsh_index_destroy();
+}
+
+/**
+ * Builds a sharded snapshot with num_shards shards and times num_queries
+ * each of degrees of connection, mutual friends and friend suggestions on
+ * it, then prints throughput and memory per shard. A sample of the queries
+ * is checked against the unsharded functions.
+ */
+void bench_shards(User **users, int num_users, int num_queries, int num_shards)
+{
+  double start = now_seconds();
+  ShardedGraph *g = shard_graph_build(num_shards);
+  double build_time = now_seconds() - start;
+  if (g == NULL)
+  {
+    printf("Could not build %d shards\n", num_shards);
+    return;
+  }
+
+  srand(99); // The same query users for every shard count
+  int mismatches = 0;
+  double degrees_time = 0;
+  double mutual_time = 0;
+  double suggest_time = 0;
+  for (int q = 0; q < num_queries; q++)
+  {
+    User *a = users[rand() % num_users];
+    User *b = users[rand() % num_users];
+
+    start = now_seconds();
+    int degrees = sharded_degrees_of_connection(g, a->name, b->name);
+    degrees_time += now_seconds() - start;
+
+    start = now_seconds();
+    int mutual = sharded_mutual_friends(g, a->name, b->name);
+    mutual_time += now_seconds() - start;
+
+    start = now_seconds();
+    char *suggestion = sharded_suggested_friend(g, a->name);
+    suggest_time += now_seconds() - start;
+
+    if (q < 20)
+    {
+      User *expected = get_suggested_friend(a);
+      if (degrees != get_degrees_of_connection(a, b) || mutual != get_mutual_friends(a, b) ||
+          (expected == NULL) != (suggestion == NULL) || (expected != NULL && strcmp(expected->name, suggestion) != 0))
+        mismatches++;
+    }
+  }
+
+  size_t total_bytes = 0;
+  size_t max_bytes = 0;
+  long ghost_edges = 0;
+  long edges = 0;
+  for (int i = 0; i < num_shards; i++)
+  {
+    Shard *s = &g->shards[i];
+    total_bytes += s->bytes;
+    max_bytes = s->bytes > max_bytes ? s->bytes : max_bytes;
+    ghost_edges += s->ghost_start[s->num_users];
+    edges += s->local_start[s->num_users] + s->ghost_start[s->num_users];
+  }
+
+  printf("%d shards: degrees %.0f/s, mutual %.0f/s, suggest %.0f/s, build %.1f ms\n", num_shards,
+         num_queries / degrees_time, num_queries / mutual_time, num_queries / suggest_time, 1e3 * build_time);
+  printf("   memory per shard %.1f KB avg, %.1f KB max; %.1f%% ghost edges; %.1f ints sent per query; %d mismatches\n",
+         total_bytes / 1024.0 / num_shards, max_bytes / 1024.0, edges ? 100.0 * ghost_edges / edges : 0.0,
+         (double)g->messages / (3 * num_queries), mismatches);
+  shard_graph_free(g);
+}
+
+int main(int argc, char **argv)
+{
+  int num_users = argc > 1 ? atoi(argv[1]) : 10000;
+  int num_queries = argc > 2 ? atoi(argv[2]) : 200;
+  if (num_users <= 1 || num_queries <= 0)
+  {
+    printf("Usage: %s [num_users] [num_queries]\n", argv[0]);
+    return 1;
+  }
+
+  srand(42);
+  double start = now_seconds();
+  User **users = build_platform(num_users);
+  printf("Built %d users over %d brands in %.1f ms\n", num_users, MAT_SIZE, 1e3 * (now_seconds() - start));
+
+  bench_lsh(users, num_users, num_queries, 32, 2);
+  bench_lsh(users, num_users, num_queries, 20, 3);
+  bench_lsh(users, num_users, num_queries, 16, 4);
+  bench_lsh(users, num_users, num_queries, 8, 8);
+
+  bench_shards(users, num_users, num_queries, 1);
+  bench_shards(users, num_users, num_queries, 2);
+  bench_shards(users, num_users, num_queries, 4);
+  bench_shards(users, num_users, num_queries, 8);
+
+  free(users);
+  return 0;
+}
@@ -0,0 +1,431 @@
+/**
+ * Load-testing client for graffit_server.c. Creates a random platform
+ * through the server, then drives it from several connections at once, each
+ * keeping a window of pipelined queries in flight, and reports throughput
+ * and latency.
+ *
+ * Build and run with:
+ *   gcc -O2 graffit_loadgen.c -o graffit_loadgen -pthread
+ *   ./graffit_loadgen [-p port | -u socket_path] [-b brands.csv] [-n users]
+ *                     [-c connections] [-r requests_per_connection] [-d depth]
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "graffit_protocol.h"
+
+#define MAX_BRANDS 1024
+
+typedef struct client_struct
+{
+  int fd;
+  unsigned char *out;
+  int out_len;
+  int out_cap;
+  uint32_t next_id;
+} Client;
+
+typedef struct worker_struct
+{
+  int seed;
+  int num_requests;
+  double *latencies; // Round trip of each pipelined window, in seconds
+  int num_windows;
+  long num_sent; // Requests sent and answered, for the throughput figure
+  int errors;
+} Worker;
+
+char *socket_path = NULL;
+int port = GRAFFIT_DEFAULT_PORT;
+int num_users = 1000;
+int friends_per_user = 4;
+int depth = 32;
+char brand_names[MAX_BRANDS][GRAFFIT_MAX_NAME + 1];
+int num_brands = 0;
+
+/**
+ * Returns the current time in seconds.
+ */
+double now_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Connects to the server. Returns 0, or -1 on failure.
+ */
+int client_connect(Client *c)
+{
+  memset(c, 0, sizeof(Client));
+  if (socket_path != NULL)
+  {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    return c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ? -1 : 0;
+  }
+
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  c->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    return -1;
+  int one = 1;
+  setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return 0;
+}
+
+/**
+ * Queues a request frame with up to two names and a count. Unused names are
+ * NULL; n is only sent for GRAFFIT_OP_FOLLOW_SUGGESTED.
+ */
+void client_queue(Client *c, int op, const char *a, const char *b, int n)
+{
+  int need = c->out_len + 4 + 5 + 2 * (2 + GRAFFIT_MAX_NAME) + 4;
+  if (need > c->out_cap)
+  {
+    c->out_cap = need * 2;
+    c->out = realloc(c->out, c->out_cap);
+    if (c->out == NULL)
+    {
+      perror("realloc");
+      exit(1);
+    }
+  }
+
+  int start = c->out_len;
+  int len = start + 4;
+  graffit_put_u32(c->out + len, c->next_id++);
+  c->out[len + 4] = (unsigned char)op;
+  len += 5;
+  if (a != NULL)
+    graffit_put_name(c->out, &len, a);
+  if (b != NULL)
+    graffit_put_name(c->out, &len, b);
+  if (op == GRAFFIT_OP_FOLLOW_SUGGESTED)
+  {
+    graffit_put_u32(c->out + len, (uint32_t)n);
+    len += 4;
+  }
+  graffit_put_u32(c->out + start, len - start - 4);
+  c->out_len = len;
+}
+
+/**
+ * Reads exactly len bytes. Returns 0, or -1 if the connection failed.
+ */
+int read_full(int fd, unsigned char *buf, int len)
+{
+  int got = 0;
+  while (got < len)
+  {
+    ssize_t n = read(fd, buf + got, len - got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    got += n;
+  }
+  return 0;
+}
+
+/**
+ * Sends every queued request, then reads one response per request and checks
+ * they arrive in order. Stores the results in results if it is not NULL.
+ * Returns the number of responses read, or -1 if the connection failed.
+ */
+int client_flush(Client *c, uint32_t first_id, int count, int *results)
+{
+  int sent = 0;
+  while (sent < c->out_len)
+  {
+    ssize_t n = write(c->fd, c->out + sent, c->out_len - sent);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    sent += n;
+  }
+  c->out_len = 0;
+
+  unsigned char body[GRAFFIT_MAX_FRAME];
+  for (int i = 0; i < count; i++)
+  {
+    unsigned char header[4];
+    if (read_full(c->fd, header, 4) != 0)
+      return -1;
+    uint32_t len = graffit_get_u32(header);
+    if (len < 10 || len > GRAFFIT_MAX_FRAME || read_full(c->fd, body, len) != 0)
+      return -1;
+    if (graffit_get_u32(body) != first_id + i)
+    {
+      fprintf(stderr, "Response %u arrived out of order\n", graffit_get_u32(body));
+      return -1;
+    }
+    if (results != NULL)
+      results[i] = (int32_t)graffit_get_u32(body + 4);
+  }
+  return count;
+}
+
+/**
+ * Reads the brand names from the first line of a brands file, in the format
+ * populate_brand_matrix expects.
+ */
+void load_brands(char *file_name)
+{
+  FILE *f = fopen(file_name, "r");
+  if (f == NULL)
+  {
+    perror(file_name);
+    exit(1);
+  }
+  char line[65536];
+  if (fscanf(f, "%65535s", line) == 1)
+  {
+    for (char *name = strtok(line, ","); name != NULL && num_brands < MAX_BRANDS; name = strtok(NULL, ","))
+      snprintf(brand_names[num_brands++], GRAFFIT_MAX_NAME + 1, "%s", name);
+  }
+  fclose(f);
+}
+
+/**
+ * Writes the name of user i into buf.
+ */
+void user_name(char *buf, int i)
+{
+  sprintf(buf, "load%07d", i);
+}
+
+/**
+ * Creates the users, friendships and follows the workers query.
+ */
+int build_platform()
+{
+  Client c;
+  if (client_connect(&c) != 0)
+  {
+    perror("connect");
+    return -1;
+  }
+
+  char a[32];
+  char b[32];
+  double start = now_seconds();
+  for (int i = 0; i < num_users; i += depth)
+  {
+    uint32_t first = c.next_id;
+    int count = 0;
+    for (int j = i; j < num_users && j < i + depth; j++, count++)
+    {
+      user_name(a, j);
+      client_queue(&c, GRAFFIT_OP_CREATE_USER, a, NULL, 0);
+    }
+    if (client_flush(&c, first, count, NULL) != count)
+      return -1;
+  }
+
+  srand(1);
+  for (int i = 0; i < num_users; i++)
+  {
+    uint32_t first = c.next_id;
+    int count = 0;
+    user_name(a, i);
+    for (int j = 0; j < friends_per_user; j++, count++)
+    {
+      user_name(b, rand() % num_users);
+      client_queue(&c, GRAFFIT_OP_ADD_FRIEND, a, b, 0);
+    }
+    for (int j = 0; num_brands > 0 && j < 5; j++, count++)
+      client_queue(&c, GRAFFIT_OP_FOLLOW_BRAND, a, brand_names[rand() % num_brands], 0);
+    if (client_flush(&c, first, count, NULL) != count)
+      return -1;
+  }
+
+  printf("Built %d users in %.1f ms\n", num_users, 1e3 * (now_seconds() - start));
+  close(c.fd);
+  free(c.out);
+  return 0;
+}
+
+/**
+ * Sends a mix of queries in windows of depth pipelined requests: mostly
+ * degrees of connection, then mutual friends, friend suggestions and brand
+ * suggestions, with the odd new friendship to invalidate cached results.
+ */
+void *run_worker(void *arg)
+{
+  Worker *w = arg;
+  Client c;
+  if (client_connect(&c) != 0)
+  {
+    w->errors++;
+    return NULL;
+  }
+
+  unsigned int seed = w->seed;
+  char a[32];
+  char b[32];
+  int windows = (w->num_requests + depth - 1) / depth;
+  w->latencies = malloc(windows * sizeof(double));
+
+  for (int done = 0; done < w->num_requests && w->latencies != NULL;)
+  {
+    uint32_t first = c.next_id;
+    int count = 0;
+    for (; count < depth && done + count < w->num_requests; count++)
+    {
+      int kind = rand_r(&seed) % 100;
+      user_name(a, rand_r(&seed) % num_users);
+      user_name(b, rand_r(&seed) % num_users);
+      if (kind < 60)
+        client_queue(&c, GRAFFIT_OP_DEGREES, a, b, 0);
+      else if (kind < 80)
+        client_queue(&c, GRAFFIT_OP_MUTUAL_FRIENDS, a, b, 0);
+      else if (kind < 93)
+        client_queue(&c, GRAFFIT_OP_SUGGEST_FRIEND, a, NULL, 0);
+      else if (kind < 98)
+        client_queue(&c, GRAFFIT_OP_FOLLOW_SUGGESTED, a, NULL, 1 + rand_r(&seed) % 2);
+      else
+        client_queue(&c, GRAFFIT_OP_ADD_FRIEND, a, b, 0);
+    }
+
+    double start = now_seconds();
+    if (client_flush(&c, first, count, NULL) != count)
+    {
+      w->errors++;
+      break;
+    }
+    w->latencies[w->num_windows++] = now_seconds() - start;
+    w->num_sent += count;
+    done += count;
+  }
+
+  close(c.fd);
+  free(c.out);
+  return NULL;
+}
+
+/**
+ * Compares two latencies. Used with qsort.
+ */
+int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+  int num_connections = 4;
+  int requests_per_connection = 20000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "u:p:b:n:c:r:d:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'u':
+      socket_path = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'b':
+      load_brands(optarg);
+      break;
+    case 'n':
+      num_users = atoi(optarg);
+      break;
+    case 'c':
+      num_connections = atoi(optarg);
+      break;
+    case 'r':
+      requests_per_connection = atoi(optarg);
+      break;
+    case 'd':
+      depth = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-p port | -u socket_path] [-b brands.csv] [-n users] "
+                      "[-c connections] [-r requests_per_connection] [-d depth]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (num_users <= 0 || num_connections <= 0 || requests_per_connection <= 0 || depth <= 0)
+  {
+    fprintf(stderr, "All counts must be positive.\n");
+    return 1;
+  }
+
+  if (build_platform() != 0)
+    return 1;
+
+  Worker *workers = calloc(num_connections, sizeof(Worker));
+  pthread_t *threads = calloc(num_connections, sizeof(pthread_t));
+  double start = now_seconds();
+  for (int i = 0; i < num_connections; i++)
+  {
+    workers[i].seed = 1000 + i;
+    workers[i].num_requests = requests_per_connection;
+    pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+  }
+  for (int i = 0; i < num_connections; i++)
+    pthread_join(threads[i], NULL);
+  double elapsed = now_seconds() - start;
+
+  int total_windows = 0;
+  int errors = 0;
+  for (int i = 0; i < num_connections; i++)
+  {
+    total_windows += workers[i].num_windows;
+    errors += workers[i].errors;
+  }
+  double *latencies = malloc((total_windows + 1) * sizeof(double));
+  long total_requests = 0;
+  int k = 0;
+  for (int i = 0; i < num_connections; i++)
+  {
+    for (int j = 0; j < workers[i].num_windows; j++)
+      latencies[k++] = workers[i].latencies[j];
+    total_requests += workers[i].num_sent;
+    free(workers[i].latencies);
+  }
+  qsort(latencies, total_windows, sizeof(double), compare_doubles);
+
+  printf("%d connections x depth %d: %.0f requests/s over %.2f s\n", num_connections, depth,
+         total_requests / elapsed, elapsed);
+  if (total_windows > 0)
+  {
+    printf("Window round trip: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           1e6 * latencies[total_windows / 2], 1e6 * latencies[(int)(total_windows * 0.99)],
+           1e6 * latencies[total_windows - 1]);
+  }
+  if (errors > 0)
+    printf("%d connections failed\n", errors);
+
+  free(latencies);
+  free(workers);
+  free(threads);
+  return errors > 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * Wire protocol shared by graffit_server.c and graffit_loadgen.c.
+ *
+ * Every message is a frame: a 4-byte body length followed by the body.
+ * All integers are little-endian.
+ *
+ * Request body:  u32 request_id, u8 op, then the op's arguments. A name is
+ *                sent as a u16 length followed by that many bytes; a count
+ *                is sent as an i32.
+ * Response body: u32 request_id, i32 result, u16 name length, name bytes.
+ *
+ * Requests may be pipelined: a client can send any number of frames without
+ * waiting, and the responses on a connection come back in request order.
+ */
+
+#ifndef GRAFFIT_PROTOCOL_H
+#define GRAFFIT_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define GRAFFIT_DEFAULT_PORT 7311
+#define GRAFFIT_MAX_FRAME 4096 // Largest body either side will accept
+#define GRAFFIT_MAX_NAME 1023  // Longest name, MAX_STR_LEN - 1 in graffit.c
+
+// Ops and their arguments. Result is the graffit.c function's return value.
+#define GRAFFIT_OP_CREATE_USER 1         // name -> 0, or -1 if it exists
+#define GRAFFIT_OP_DELETE_USER 2         // name -> delete_user
+#define GRAFFIT_OP_ADD_FRIEND 3          // name, name -> add_friend
+#define GRAFFIT_OP_REMOVE_FRIEND 4       // name, name -> remove_friend
+#define GRAFFIT_OP_FOLLOW_BRAND 5        // name, brand -> follow_brand
+#define GRAFFIT_OP_UNFOLLOW_BRAND 6      // name, brand -> unfollow_brand
+#define GRAFFIT_OP_MUTUAL_FRIENDS 7      // name, name -> get_mutual_friends
+#define GRAFFIT_OP_DEGREES 8             // name, name -> get_degrees_of_connection
+#define GRAFFIT_OP_SUGGEST_FRIEND 9      // name -> 0 and the suggested name, or -1
+#define GRAFFIT_OP_FOLLOW_SUGGESTED 10   // name, i32 n -> follow_suggested_brands
+
+static inline void graffit_put_u16(unsigned char *p, uint16_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static inline void graffit_put_u32(unsigned char *p, uint32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static inline uint16_t graffit_get_u16(const unsigned char *p)
+{
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t graffit_get_u32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Appends a u16-length-prefixed name at buf + *len. Returns -1 if the name
+ * is too long, 0 otherwise. The caller makes sure buf has room.
+ */
+static inline int graffit_put_name(unsigned char *buf, int *len, const char *name)
+{
+  size_t n = strlen(name);
+  if (n > GRAFFIT_MAX_NAME)
+    return -1;
+  graffit_put_u16(buf + *len, (uint16_t)n);
+  memcpy(buf + *len + 2, name, n);
+  *len += 2 + (int)n;
+  return 0;
+}
+
+/**
+ * Reads a u16-length-prefixed name at body + *pos into out, which must hold
+ * GRAFFIT_MAX_NAME + 1 bytes. Returns -1 if it runs past body_len or is too
+ * long, 0 otherwise.
+ */
+static inline int graffit_get_name(const unsigned char *body, int body_len, int *pos, char *out)
+{
+  if (*pos + 2 > body_len)
+    return -1;
+  int n = graffit_get_u16(body + *pos);
+  if (n > GRAFFIT_MAX_NAME || *pos + 2 + n > body_len)
+    return -1;
+  memcpy(out, body + *pos + 2, n);
+  out[n] = '\0';
+  *pos += 2 + n;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,912 @@
+/**
+ * Standalone query server for graffit.c. Holds one shared graph and answers
+ * the requests described in graffit_protocol.h over localhost TCP or a Unix
+ * domain socket, using a single-threaded epoll event loop.
+ *
+ * Each pass of the loop reads from every ready connection, queues up to
+ * MAX_FRAMES_PER_CONN complete frames from each one, executes the queue in
+ * arrival order and then writes the responses back. When the queue fills,
+ * the next pass starts with the connection that was cut off, so a client
+ * that pipelines deeply can't starve the others. A connection with more
+ * than IN_HIGH_WATER bytes of unread requests or OUT_HIGH_WATER bytes of
+ * unsent responses is not read from until it drains. Within the queue, runs of degrees-of-connection queries
+ * are answered with one breadth-first search per source user through
+ * get_degrees_of_connection_batch, and runs of brand suggestions go through
+ * follow_suggested_brands_batch. Mutations split the runs, so the results
+ * are the same as executing the requests one at a time.
+ *
+ * The brand catalog is fixed at compile time, so build with MAT_SIZE set to
+ * the number of brands in the file; a file that doesn't match is rejected.
+ *
+ * Build and run with:
+ *   gcc -O2 -DMAT_SIZE=<catalog size> graffit_server.c -o graffit_server -lm -pthread
+ *   ./graffit_server -b brands.csv [-p port | -u socket_path] [-c cache_bytes] [-q]
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "graffit.c"
+#include "graffit_protocol.h"
+
+#define MAX_EVENTS 64
+#define MAX_BATCH 1024 // Requests executed per pass of the event loop
+#define MAX_FRAMES_PER_CONN 64 // Requests one connection may add to a single batch
+#define READ_CHUNK 65536
+#define IN_HIGH_WATER (1 << 20)  // Buffered input at which reading pauses
+#define OUT_HIGH_WATER (1 << 20) // Unsent output at which reading and queueing pause
+
+typedef struct connection_struct
+{
+  int fd;
+  unsigned char *in;
+  int in_len;
+  int in_cap;
+  unsigned char *out;
+  int out_len;
+  int out_sent;
+  int out_cap;
+  bool eof;         // Peer has stopped sending; close once everything is answered
+  bool closing;     // Freed once the current batch is done
+  uint32_t events;  // Events the connection is registered for
+  bool has_pending; // Complete frames left in the input after this pass
+  struct connection_struct *next;
+} Connection;
+
+typedef struct request_struct
+{
+  Connection *conn;
+  uint32_t id;
+  int op;
+  char a[MAX_STR_LEN];
+  char b[MAX_STR_LEN]; // Also holds the name returned by GRAFFIT_OP_SUGGEST_FRIEND
+  int n;
+  int result;
+  bool done;
+} Request;
+
+typedef struct server_stats_struct
+{
+  unsigned long requests;
+  unsigned long batches;
+  unsigned long degree_searches;  // Breadth-first searches run for degree queries
+  unsigned long degree_queries;
+  unsigned long brand_batches;
+} ServerStats;
+
+int epoll_fd = -1;
+Connection *connections = NULL;
+Connection *next_turn = NULL; // Where the next batch starts filling, after a full one
+Request batch[MAX_BATCH];
+int batch_len = 0;
+ServerStats server_stats = {0};
+volatile sig_atomic_t stop_requested = 0;
+
+/*
+ * Name -> User index, so requests don't scan allUsers. Chained hash table
+ * that doubles when it gets more than two users per bucket.
+ */
+
+typedef struct user_index_node_struct
+{
+  User *user;
+  struct user_index_node_struct *next;
+} UserIndexNode;
+
+UserIndexNode **user_index = NULL;
+int user_index_buckets = 0;
+int user_index_count = 0;
+
+/**
+ * Returns the bucket a user name hashes to.
+ */
+int user_index_slot(char *name, int buckets)
+{
+  return (int)(hash_name(name) % (unsigned long)buckets);
+}
+
+/**
+ * Returns the user with the given name, or NULL if there is none.
+ */
+User *find_user(char *name)
+{
+  if (user_index_buckets == 0)
+    return NULL;
+  for (UserIndexNode *n = user_index[user_index_slot(name, user_index_buckets)]; n != NULL; n = n->next)
+  {
+    if (strcmp(n->user->name, name) == 0)
+      return n->user;
+  }
+  return NULL;
+}
+
+/**
+ * Adds a user to the name index, growing it if needed.
+ */
+void user_index_add(User *user)
+{
+  if (user_index_count >= 2 * user_index_buckets)
+  {
+    int buckets = user_index_buckets ? 2 * user_index_buckets : 1024;
+    UserIndexNode **table = calloc(buckets, sizeof(UserIndexNode *));
+    if (table == NULL)
+      return;
+    for (int i = 0; i < user_index_buckets; i++)
+    {
+      UserIndexNode *n = user_index[i];
+      while (n != NULL)
+      {
+        UserIndexNode *next = n->next;
+        int slot = user_index_slot(n->user->name, buckets);
+        n->next = table[slot];
+        table[slot] = n;
+        n = next;
+      }
+    }
+    free(user_index);
+    user_index = table;
+    user_index_buckets = buckets;
+  }
+
+  UserIndexNode *node = malloc(sizeof(UserIndexNode));
+  if (node == NULL)
+    return;
+  int slot = user_index_slot(user->name, user_index_buckets);
+  node->user = user;
+  node->next = user_index[slot];
+  user_index[slot] = node;
+  user_index_count++;
+}
+
+/**
+ * Removes a user from the name index.
+ */
+void user_index_remove(User *user)
+{
+  UserIndexNode **link = &user_index[user_index_slot(user->name, user_index_buckets)];
+  while (*link != NULL && (*link)->user != user)
+    link = &(*link)->next;
+  if (*link == NULL)
+    return;
+  UserIndexNode *temp = *link;
+  *link = temp->next;
+  free(temp);
+  user_index_count--;
+}
+
+/**
+ * Makes sure buf can hold need bytes, doubling its capacity as required.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int reserve(unsigned char **buf, int *cap, int need)
+{
+  if (need <= *cap)
+    return 0;
+  int new_cap = *cap ? *cap : 4096;
+  while (new_cap < need)
+    new_cap *= 2;
+  unsigned char *grown = realloc(*buf, new_cap);
+  if (grown == NULL)
+    return -1;
+  *buf = grown;
+  *cap = new_cap;
+  return 0;
+}
+
+/**
+ * Parses the request frame body at body into r. Returns 0, or -1 if the
+ * frame is malformed.
+ */
+int parse_request(unsigned char *body, int len, Request *r)
+{
+  if (len < 5)
+    return -1;
+  r->id = graffit_get_u32(body);
+  r->op = body[4];
+  r->a[0] = '\0';
+  r->b[0] = '\0';
+  r->n = 0;
+  r->result = -1;
+  r->done = false;
+
+  int pos = 5;
+  switch (r->op)
+  {
+  case GRAFFIT_OP_CREATE_USER:
+  case GRAFFIT_OP_DELETE_USER:
+  case GRAFFIT_OP_SUGGEST_FRIEND:
+    return graffit_get_name(body, len, &pos, r->a);
+  case GRAFFIT_OP_ADD_FRIEND:
+  case GRAFFIT_OP_REMOVE_FRIEND:
+  case GRAFFIT_OP_FOLLOW_BRAND:
+  case GRAFFIT_OP_UNFOLLOW_BRAND:
+  case GRAFFIT_OP_MUTUAL_FRIENDS:
+  case GRAFFIT_OP_DEGREES:
+    if (graffit_get_name(body, len, &pos, r->a) != 0)
+      return -1;
+    return graffit_get_name(body, len, &pos, r->b);
+  case GRAFFIT_OP_FOLLOW_SUGGESTED:
+    if (graffit_get_name(body, len, &pos, r->a) != 0 || pos + 4 > len)
+      return -1;
+    r->n = (int32_t)graffit_get_u32(body + pos);
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+/**
+ * Moves up to max_frames complete frames from a connection's input into the
+ * batch, stopping early if the batch fills. Returns 0, or -1 if a frame is
+ * malformed.
+ */
+int queue_requests(Connection *c, int max_frames)
+{
+  int pos = 0;
+  int queued = 0;
+  c->has_pending = false;
+  while (c->in_len - pos >= 4)
+  {
+    uint32_t frame_len = graffit_get_u32(c->in + pos);
+    if (frame_len > GRAFFIT_MAX_FRAME)
+      return -1;
+    int len = (int)frame_len;
+    if (c->in_len - pos - 4 < len)
+      break;
+    if (batch_len == MAX_BATCH || queued == max_frames)
+    {
+      c->has_pending = true;
+      break;
+    }
+    Request *r = &batch[batch_len];
+    if (parse_request(c->in + pos + 4, len, r) != 0)
+      return -1;
+    r->conn = c;
+    batch_len++;
+    queued++;
+    pos += 4 + len;
+  }
+  if (pos > 0)
+  {
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+  }
+  return 0;
+}
+
+/**
+ * Executes a single request that has no batch engine.
+ */
+void execute_request(Request *r)
+{
+  User *a = find_user(r->a);
+  User *b = find_user(r->b);
+
+  switch (r->op)
+  {
+  case GRAFFIT_OP_CREATE_USER:
+    a = create_user(r->a);
+    if (a != NULL)
+      user_index_add(a);
+    r->result = a != NULL ? 0 : -1;
+    break;
+  case GRAFFIT_OP_DELETE_USER:
+    if (a != NULL)
+      user_index_remove(a);
+    r->result = a != NULL ? delete_user(a) : -1;
+    break;
+  case GRAFFIT_OP_ADD_FRIEND:
+    r->result = a != NULL && b != NULL && a != b ? add_friend(a, b) : -1;
+    break;
+  case GRAFFIT_OP_REMOVE_FRIEND:
+    r->result = remove_friend(a, b);
+    break;
+  case GRAFFIT_OP_FOLLOW_BRAND:
+    r->result = a != NULL ? follow_brand(a, r->b) : -1;
+    break;
+  case GRAFFIT_OP_UNFOLLOW_BRAND:
+    r->result = a != NULL ? unfollow_brand(a, r->b) : -1;
+    break;
+  case GRAFFIT_OP_MUTUAL_FRIENDS:
+    r->result = get_mutual_friends(a, b);
+    break;
+  case GRAFFIT_OP_DEGREES:
+    r->result = get_degrees_of_connection(a, b);
+    break;
+  case GRAFFIT_OP_SUGGEST_FRIEND:
+  {
+    User *suggestion = get_suggested_friend(a);
+    r->result = suggestion != NULL ? 0 : -1;
+    strcpy(r->b, suggestion != NULL ? suggestion->name : "");
+    break;
+  }
+  case GRAFFIT_OP_FOLLOW_SUGGESTED:
+    r->result = a != NULL && r->n > 0 ? follow_suggested_brands(a, r->n) : 0;
+    break;
+  }
+  r->done = true;
+}
+
+/**
+ * Answers the degree queries in batch[first .. last) with one breadth-first
+ * search per distinct source user.
+ */
+void execute_degrees(int first, int last)
+{
+  int len = last - first;
+  User **sources = malloc(len * sizeof(User *));
+  User **targets = malloc(len * sizeof(User *));
+  int *group = malloc(len * sizeof(int));
+  int *degrees = malloc(len * sizeof(int));
+  if (sources == NULL || targets == NULL || group == NULL || degrees == NULL)
+  {
+    free(sources);
+    free(targets);
+    free(group);
+    free(degrees);
+    for (int i = first; i < last; i++)
+      execute_request(&batch[i]);
+    return;
+  }
+
+  for (int i = 0; i < len; i++)
+    sources[i] = find_user(batch[first + i].a);
+
+  for (int i = 0; i < len; i++)
+  {
+    if (batch[first + i].done)
+      continue;
+    User *source = sources[i];
+
+    int count = 0;
+    for (int j = i; j < len; j++)
+    {
+      Request *r = &batch[first + j];
+      if (!r->done && (j == i || (source != NULL && sources[j] == source)))
+      {
+        group[count] = first + j;
+        targets[count++] = find_user(r->b);
+        r->done = true;
+      }
+    }
+
+    if (source == NULL || get_degrees_of_connection_batch(source, targets, count, degrees) != 0)
+    {
+      for (int k = 0; k < count; k++)
+        degrees[k] = -1;
+    }
+    for (int k = 0; k < count; k++)
+      batch[group[k]].result = degrees[k];
+    server_stats.degree_searches++;
+    server_stats.degree_queries += count;
+  }
+
+  free(sources);
+  free(targets);
+  free(group);
+  free(degrees);
+}
+
+/**
+ * Answers the brand suggestion requests in batch[first .. last), which all
+ * ask for the same number of brands, with one follow_suggested_brands_batch call.
+ */
+void execute_follow_suggested(int first, int last)
+{
+  User **users = malloc((last - first) * sizeof(User *));
+  int *followed = malloc((last - first) * sizeof(int));
+  if (users == NULL || followed == NULL || batch[first].n <= 0)
+  {
+    free(users);
+    free(followed);
+    for (int i = first; i < last; i++)
+      execute_request(&batch[i]);
+    return;
+  }
+
+  for (int i = first; i < last; i++)
+    users[i - first] = find_user(batch[i].a);
+  follow_suggested_brands_batch(users, last - first, batch[first].n, followed);
+  for (int i = first; i < last; i++)
+  {
+    batch[i].result = followed[i - first];
+    batch[i].done = true;
+  }
+  server_stats.brand_batches++;
+
+  free(users);
+  free(followed);
+}
+
+/**
+ * Executes the whole batch in arrival order, handing runs of degree queries
+ * and of brand suggestions to the batch engines.
+ */
+void execute_batch()
+{
+  int i = 0;
+  while (i < batch_len)
+  {
+    int j = i + 1;
+    if (batch[i].op == GRAFFIT_OP_DEGREES)
+    {
+      while (j < batch_len && batch[j].op == GRAFFIT_OP_DEGREES)
+        j++;
+      execute_degrees(i, j);
+    }
+    else if (batch[i].op == GRAFFIT_OP_FOLLOW_SUGGESTED)
+    {
+      while (j < batch_len && batch[j].op == GRAFFIT_OP_FOLLOW_SUGGESTED && batch[j].n == batch[i].n)
+        j++;
+      execute_follow_suggested(i, j);
+    }
+    else
+    {
+      execute_request(&batch[i]);
+    }
+    i = j;
+  }
+  server_stats.requests += batch_len;
+  server_stats.batches++;
+}
+
+/**
+ * Appends the response to r to its connection's output.
+ */
+void queue_response(Request *r)
+{
+  Connection *c = r->conn;
+  if (c->closing)
+    return;
+
+  int name_len = r->op == GRAFFIT_OP_SUGGEST_FRIEND ? (int)strlen(r->b) : 0;
+  int frame_len = 4 + 4 + 4 + 2 + name_len;
+  if (reserve(&c->out, &c->out_cap, c->out_len + frame_len) != 0)
+  {
+    c->closing = true;
+    return;
+  }
+
+  unsigned char *p = c->out + c->out_len;
+  graffit_put_u32(p, frame_len - 4);
+  graffit_put_u32(p + 4, r->id);
+  graffit_put_u32(p + 8, (uint32_t)r->result);
+  graffit_put_u16(p + 12, (uint16_t)name_len);
+  memcpy(p + 14, r->b, name_len);
+  c->out_len += frame_len;
+}
+
+/**
+ * Returns true if a connection has so many unsent responses that it should
+ * not be given any more requests until the peer reads some.
+ */
+bool output_backed_up(Connection *c)
+{
+  return c->out_len - c->out_sent >= OUT_HIGH_WATER;
+}
+
+/**
+ * Registers a connection for input until the peer stops sending, except
+ * while either of its buffers is past its high-water mark, and for output
+ * while it has output left to send.
+ */
+void update_interest(Connection *c)
+{
+  bool wants_input = !c->eof && c->in_len < IN_HIGH_WATER && !output_backed_up(c);
+  uint32_t events = (wants_input ? EPOLLIN : 0) | (c->out_sent < c->out_len ? EPOLLOUT : 0);
+  if (events == c->events)
+    return;
+  struct epoll_event ev = {0};
+  ev.events = events;
+  ev.data.ptr = c;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+  c->events = events;
+}
+
+/**
+ * Writes as much of a connection's output as the socket will take.
+ */
+void flush_output(Connection *c)
+{
+  while (c->out_sent < c->out_len)
+  {
+    ssize_t n = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        c->closing = true;
+      break;
+    }
+    c->out_sent += n;
+  }
+  if (c->out_sent == c->out_len)
+  {
+    c->out_sent = 0;
+    c->out_len = 0;
+  }
+  if (!c->closing)
+    update_interest(c);
+}
+
+/**
+ * Reads what is available on a connection into its input buffer, up to
+ * IN_HIGH_WATER bytes.
+ */
+void read_input(Connection *c)
+{
+  while (!c->closing && !c->eof && c->in_len < IN_HIGH_WATER)
+  {
+    if (reserve(&c->in, &c->in_cap, c->in_len + READ_CHUNK) != 0)
+    {
+      c->closing = true;
+      return;
+    }
+    ssize_t n = read(c->fd, c->in + c->in_len, READ_CHUNK);
+    if (n > 0)
+    {
+      c->in_len += n;
+      continue;
+    }
+    if (n == 0)
+    {
+      c->eof = true; // Requests already received are still answered
+      update_interest(c);
+    }
+    else if (errno == EINTR)
+      continue;
+    else if (errno != EAGAIN && errno != EWOULDBLOCK)
+      c->closing = true;
+    return;
+  }
+}
+
+/**
+ * Accepts every pending connection on the listening socket.
+ */
+void accept_connections(int listen_fd)
+{
+  while (true)
+  {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+
+    Connection *c = calloc(1, sizeof(Connection));
+    if (c == NULL)
+    {
+      close(fd);
+      continue;
+    }
+    c->fd = fd;
+    c->events = EPOLLIN;
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+      close(fd);
+      free(c);
+      continue;
+    }
+    c->next = connections;
+    connections = c;
+  }
+}
+
+/**
+ * Closes and frees every connection that failed, or whose peer has stopped
+ * sending and has been sent every response.
+ */
+void reap_connections()
+{
+  Connection **link = &connections;
+  while (*link != NULL)
+  {
+    Connection *c = *link;
+    if (c->eof && !c->has_pending && c->out_len == 0)
+      c->closing = true;
+    if (!c->closing)
+    {
+      link = &c->next;
+      continue;
+    }
+    *link = c->next;
+    if (next_turn == c)
+      next_turn = c->next;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+  }
+}
+
+/**
+ * Opens the listening socket: a Unix domain socket if socket_path is not
+ * NULL, otherwise TCP on 127.0.0.1:port. Returns the socket, or -1.
+ */
+int open_listener(char *socket_path, int port)
+{
+  int fd;
+  if (socket_path != NULL)
+  {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+      return -1;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+      return -1;
+  }
+  else
+  {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+      return -1;
+  }
+  if (listen(fd, 128) != 0)
+    return -1;
+  return fd;
+}
+
+/**
+ * Runs the event loop until SIGINT or SIGTERM.
+ */
+void serve(int listen_fd)
+{
+  struct epoll_event events[MAX_EVENTS];
+  bool pending = false;
+
+  while (!stop_requested)
+  {
+    // Frames left over from a full batch are executed without waiting
+    int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, pending ? 0 : -1);
+    if (num_events < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("epoll_wait");
+      return;
+    }
+
+    for (int i = 0; i < num_events; i++)
+    {
+      if (events[i].data.ptr == NULL)
+      {
+        accept_connections(listen_fd);
+        continue;
+      }
+      Connection *c = events[i].data.ptr;
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        read_input(c);
+      if (events[i].events & EPOLLOUT)
+        flush_output(c);
+    }
+
+    // Fill the batch round-robin, starting where the last full batch stopped
+    batch_len = 0;
+    pending = false;
+    Connection *start = next_turn != NULL ? next_turn : connections;
+    Connection *turn = start;
+    next_turn = NULL;
+    while (turn != NULL)
+    {
+      turn->has_pending = false;
+      if (!turn->closing && !output_backed_up(turn) && queue_requests(turn, MAX_FRAMES_PER_CONN) != 0)
+        turn->closing = true; // Malformed frame: the stream can't be resynchronised
+      if (turn->has_pending)
+      {
+        pending = true;
+        if (next_turn == NULL && batch_len == MAX_BATCH)
+          next_turn = turn;
+      }
+      turn = turn->next != NULL ? turn->next : connections;
+      if (turn == start)
+        break;
+    }
+
+    if (batch_len > 0)
+    {
+      execute_batch();
+      for (int i = 0; i < batch_len; i++)
+        queue_response(&batch[i]);
+      for (Connection *c = connections; c != NULL; c = c->next)
+      {
+        if (!c->closing)
+          flush_output(c);
+      }
+    }
+    reap_connections();
+  }
+}
+
+/**
+ * Skips whitespace and reads the next word of f, the way fscanf's %s would,
+ * counting its commas. Returns the word's length, or 0 at the end of the file.
+ */
+int scan_word(FILE *f, int *commas)
+{
+  int ch = getc(f);
+  while (ch != EOF && isspace(ch))
+    ch = getc(f);
+
+  int length = 0;
+  *commas = 0;
+  for (; ch != EOF && !isspace(ch); ch = getc(f))
+  {
+    length++;
+    if (ch == ',')
+      (*commas)++;
+  }
+  return length;
+}
+
+/**
+ * Checks that an open brands file has a first line naming exactly MAT_SIZE
+ * brands, followed by MAT_SIZE matrix rows of MAT_SIZE comma-separated
+ * digits, and that every line fits the buffer populate_brand_matrix reads
+ * it into. Prints the problem and returns -1 if not, 0 otherwise.
+ */
+int check_brands_file(char *file_name, FILE *f)
+{
+  int commas;
+  int length = scan_word(f, &commas);
+  if (length == 0)
+  {
+    fprintf(stderr, "%s has no brand line\n", file_name);
+    return -1;
+  }
+  if (commas + 1 != MAT_SIZE)
+  {
+    fprintf(stderr, "%s lists %d brands but the server was built with MAT_SIZE=%d; rebuild with -DMAT_SIZE=%d\n",
+            file_name, commas + 1, MAT_SIZE, commas + 1);
+    return -1;
+  }
+  if (length >= MAX_STR_LEN)
+  {
+    fprintf(stderr, "%s: the brand line is %d characters, more than the %d graffit.c reads\n", file_name, length,
+            MAX_STR_LEN - 1);
+    return -1;
+  }
+
+  int row_length = 2 * MAT_SIZE - 1;
+  if (row_length >= MAX_STR_LEN)
+  {
+    fprintf(stderr, "Matrix rows of %d brands are longer than the %d characters graffit.c reads\n", MAT_SIZE,
+            MAX_STR_LEN - 1);
+    return -1;
+  }
+  for (int x = 0; x < MAT_SIZE; x++)
+  {
+    length = scan_word(f, &commas);
+    if (length != row_length || commas != MAT_SIZE - 1)
+    {
+      fprintf(stderr, "%s: matrix row %d is not %d comma-separated digits\n", file_name, x + 1, MAT_SIZE);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Sets the flag that stops the event loop.
+ */
+void handle_stop(int sig)
+{
+  (void)sig;
+  stop_requested = 1;
+}
+
+int main(int argc, char **argv)
+{
+  char *brands_file = NULL;
+  char *socket_path = NULL;
+  int port = GRAFFIT_DEFAULT_PORT;
+  long cache_bytes = 0;
+  bool quiet = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:u:p:c:q")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b':
+      brands_file = optarg;
+      break;
+    case 'u':
+      socket_path = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'c':
+      cache_bytes = atol(optarg);
+      break;
+    case 'q':
+      quiet = true;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s -b brands.csv [-p port | -u socket_path] [-c cache_bytes] [-q]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (brands_file != NULL)
+  {
+    FILE *f = fopen(brands_file, "r");
+    if (f == NULL)
+    {
+      perror(brands_file);
+      return 1;
+    }
+    int checked = check_brands_file(brands_file, f);
+    fclose(f);
+    if (checked != 0)
+      return 1;
+    populate_brand_matrix(brands_file);
+  }
+  if (cache_bytes > 0 && result_cache_init((size_t)cache_bytes) != 0)
+    return 1;
+  if (quiet)
+    freopen("/dev/null", "w", stdout); // graffit.c reports errors on stdout
+
+  int listen_fd = open_listener(socket_path, port);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (listen_fd < 0 || epoll_fd < 0)
+  {
+    perror("listen");
+    return 1;
+  }
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL; // The listening socket is the only NULL entry
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+  struct sigaction sa = {0};
+  sa.sa_handler = handle_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (socket_path != NULL)
+    fprintf(stderr, "graffit_server listening on %s\n", socket_path);
+  else
+    fprintf(stderr, "graffit_server listening on 127.0.0.1:%d\n", port);
+
+  serve(listen_fd);
+
+  fprintf(stderr, "Served %lu requests in %lu batches (%.1f per batch)\n", server_stats.requests,
+          server_stats.batches, server_stats.batches ? (double)server_stats.requests / server_stats.batches : 0.0);
+  fprintf(stderr, "Answered %lu degree queries with %lu searches, %lu brand suggestion batches\n",
+          server_stats.degree_queries, server_stats.degree_searches, server_stats.brand_batches);
+
+  close(listen_fd);
+  if (socket_path != NULL)
+    unlink(socket_path);
+  return 0;
+}